@@ -0,0 +1,94 @@
+// Fuzz target of the samp-ct generators, for libFuzzer (and AFL++ in libFuzzer mode):
+//		clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -DSAMP_CT_LIBFUZZER FuzzChat.cpp -lfmt -o samp-ct-fuzz
+//		./samp-ct-fuzz corpus
+// Without SAMP_CT_LIBFUZZER (the cpackage.json build) it replays the files and directories
+// given on the command line, e.g. the seed corpus or a crash found by the fuzzer.
+//
+// An input is the options JSON and the project JSON separated by a NUL byte, or only the project JSON.
+// Rejected input is the expected outcome for most of the corpus, any other exception or a crash is a bug.
+
+// Every generator of the tool, with its main() out of the way:
+#define main sampCtMain
+#include "../src/Main.cpp"
+#undef main
+
+////////////////////////////////////////////////
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data_, size_t size_)
+{
+	std::string_view input(reinterpret_cast<char const*>(data_), size_);
+	size_t separator = input.find('\0');
+	std::string_view optsContents = (separator == std::string_view::npos) ? std::string_view("{}") : input.substr(0, separator);
+	std::string_view fileContents = (separator == std::string_view::npos) ? input : input.substr(separator + 1);
+
+	try
+	{
+		auto j = json::parse(optsContents);
+		if (!j.is_object())
+			return 0;
+
+		// Runs depend only on the input, options that read or write other files are dropped:
+		for (auto field : { "usedMessagesFile", "usageScanPaths", "unusedMessagesReport", "idRegistry" })
+			j.erase(field);
+
+		AppOptions opts;
+		readAppOptions(opts, j.dump());
+
+		for (bool streaming : { false, true })
+		{
+			CliOptions cli;
+			cli.streaming = streaming;
+
+			std::optional<MessageValidator> validator;
+			GenerationContext ctx;
+			if (opts.validate)
+				ctx.validator = &validator.emplace(opts);
+
+			generateOutputFiles(opts, cli, fileContents, "fuzz.h", ctx);
+		}
+	}
+	catch (std::runtime_error const&)
+	{
+	}
+	catch (json::exception const&)
+	{
+	}
+	return 0;
+}
+
+#ifndef SAMP_CT_LIBFUZZER
+////////////////////////////////////////////////
+int main(int argc, char* argv[])
+{
+	namespace fs = std::filesystem;
+
+	std::vector<fs::path> inputs;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (fs::is_directory(argv[i]))
+		{
+			for (auto const& entry : fs::directory_iterator(argv[i]))
+			{
+				if (entry.is_regular_file())
+					inputs.push_back(entry.path());
+			}
+		}
+		else
+			inputs.emplace_back(argv[i]);
+	}
+	std::sort(inputs.begin(), inputs.end());
+
+	for (auto const& path : inputs)
+	{
+		InputFile file(path.string());
+		if (!file.isOpen())
+		{
+			fmt::print("Error: could not open \"{}\" file for reading.\n", path.string());
+			return 1;
+		}
+		LLVMFuzzerTestOneInput(reinterpret_cast<uint8_t const*>(file.contents().data()), file.contents().size());
+	}
+
+	fmt::print("Replayed {} inputs.\n", inputs.size());
+	return 0;
+}
+#endif
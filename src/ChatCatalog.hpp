@@ -0,0 +1,334 @@
+#pragma once
+
+// Reader of binary chat catalogs written by samp-ct with "emitMode": "catalog".
+// Header-only and allocation-free on lookup, so a server can map the catalog
+// at startup and replace it while running, without recompiling the gamemode.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace samp_ct
+{
+
+// File layout (native byte order, every section is 8-byte aligned):
+// CatalogHeader
+// languages:	languageCount * CatalogLanguage
+// buckets:		(2^bucketBits + 1) * u32, first index entry of every bucket of name hashes
+// index:		messageCount * CatalogMessage, sorted by name hash
+// texts:		messageCount * languageCount * CatalogString, one row per index entry
+// blob:		NUL-terminated strings
+struct CatalogHeader
+{
+	char			magic[4];			// "SCTB"
+	std::uint32_t	version;
+	std::uint32_t	languageCount;
+	std::uint32_t	messageCount;
+	std::uint32_t	bucketBits;
+	std::uint32_t	languagesOffset;
+	std::uint32_t	bucketsOffset;
+	std::uint32_t	indexOffset;
+	std::uint32_t	textsOffset;
+	std::uint32_t	blobOffset;
+	std::uint32_t	blobSize;
+	std::uint32_t	fileSize;
+};
+
+// String in the blob. Texts missing in a language have offset NoString.
+struct CatalogString
+{
+	static constexpr std::uint32_t NoString = ~std::uint32_t(0);
+
+	std::uint32_t offset;
+	std::uint32_t length;
+};
+
+struct CatalogLanguage
+{
+	CatalogString id;
+	CatalogString name;
+};
+
+struct CatalogMessage
+{
+	std::uint64_t	hash;
+	CatalogString	name;
+};
+
+constexpr char			CatalogMagic[4]	= { 'S', 'C', 'T', 'B' };
+constexpr std::uint32_t	CatalogVersion	= 1;
+
+// FNV-1a of a uniqueName, the top bits select the bucket:
+constexpr auto hashName(std::string_view name_) -> std::uint64_t
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	for (char ch : name_)
+	{
+		hash ^= static_cast<unsigned char>(ch);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Non-owning view of catalog bytes.
+class ChatCatalog
+{
+public:
+	static constexpr std::size_t npos = ~std::size_t(0);
+
+	ChatCatalog() = default;
+
+	// Validates the whole layout once, lookups don't check bounds afterwards.
+	// Returns an invalid (empty) catalog for malformed data.
+	static auto fromBytes(void const* data_, std::size_t size_) -> ChatCatalog
+	{
+		ChatCatalog catalog;
+		auto bytes = static_cast<char const*>(data_);
+		if (!bytes || size_ < sizeof(CatalogHeader) || reinterpret_cast<std::uintptr_t>(bytes) % alignof(CatalogMessage) != 0)
+			return {};
+
+		auto header = reinterpret_cast<CatalogHeader const*>(bytes);
+		if (std::memcmp(header->magic, CatalogMagic, sizeof(CatalogMagic)) != 0 || header->version != CatalogVersion
+			|| header->fileSize > size_ || header->bucketBits == 0 || header->bucketBits > 31)
+			return {};
+
+		std::uint64_t bucketCount	= std::uint64_t(1) << header->bucketBits;
+		std::uint64_t textCount		= std::uint64_t(header->messageCount) * header->languageCount;
+		auto fits = [&](std::uint32_t offset_, std::uint64_t size_)
+		{
+			return offset_ % 8 == 0 && offset_ <= header->fileSize && size_ <= header->fileSize - offset_;
+		};
+		if (!fits(header->languagesOffset, std::uint64_t(header->languageCount) * sizeof(CatalogLanguage))
+			|| !fits(header->bucketsOffset, (bucketCount + 1) * sizeof(std::uint32_t))
+			|| !fits(header->indexOffset, std::uint64_t(header->messageCount) * sizeof(CatalogMessage))
+			|| !fits(header->textsOffset, textCount * sizeof(CatalogString))
+			|| !fits(header->blobOffset, header->blobSize))
+			return {};
+
+		catalog.header		= header;
+		catalog.languages	= reinterpret_cast<CatalogLanguage const*>(bytes + header->languagesOffset);
+		catalog.buckets		= reinterpret_cast<std::uint32_t const*>(bytes + header->bucketsOffset);
+		catalog.index		= reinterpret_cast<CatalogMessage const*>(bytes + header->indexOffset);
+		catalog.texts		= reinterpret_cast<CatalogString const*>(bytes + header->textsOffset);
+		catalog.blob		= bytes + header->blobOffset;
+
+		auto validString = [&](CatalogString const& str_, bool optional_)
+		{
+			if (str_.offset == CatalogString::NoString)
+				return optional_;
+			return str_.offset <= header->blobSize && str_.length < header->blobSize - str_.offset;
+		};
+
+		for (std::uint32_t i = 0; i < header->languageCount; ++i)
+		{
+			if (!validString(catalog.languages[i].id, false) || !validString(catalog.languages[i].name, false))
+				return {};
+		}
+		for (std::uint64_t i = 0; i <= bucketCount; ++i)
+		{
+			if (catalog.buckets[i] > header->messageCount || (i > 0 && catalog.buckets[i] < catalog.buckets[i - 1]))
+				return {};
+		}
+		for (std::uint32_t i = 0; i < header->messageCount; ++i)
+		{
+			if (!validString(catalog.index[i].name, false))
+				return {};
+		}
+		for (std::uint64_t i = 0; i < textCount; ++i)
+		{
+			if (!validString(catalog.texts[i], true))
+				return {};
+		}
+		return catalog;
+	}
+
+	auto valid() const -> bool					{ return header != nullptr; }
+	auto languageCount() const -> std::size_t	{ return header ? header->languageCount : 0; }
+	auto messageCount() const -> std::size_t	{ return header ? header->messageCount : 0; }
+
+	auto languageId(std::size_t language_) const -> std::string_view	{ return string(languages[language_].id); }
+	auto languageName(std::size_t language_) const -> std::string_view	{ return string(languages[language_].name); }
+	auto messageName(std::size_t message_) const -> std::string_view	{ return string(index[message_].name); }
+
+	// Position of the language by its "id", or npos:
+	auto findLanguage(std::string_view id_) const -> std::size_t
+	{
+		for (std::size_t i = 0; i < languageCount(); ++i)
+		{
+			if (languageId(i) == id_)
+				return i;
+		}
+		return npos;
+	}
+
+	// Position of the message by its uniqueName, or npos.
+	// Only the few entries of one hash bucket are compared.
+	auto find(std::string_view uniqueName_) const -> std::size_t
+	{
+		if (!header)
+			return npos;
+
+		std::uint64_t hash = hashName(uniqueName_);
+		std::uint64_t bucket = hash >> (64 - header->bucketBits);
+		for (std::uint32_t i = buckets[bucket]; i < buckets[bucket + 1]; ++i)
+		{
+			if (index[i].hash == hash && messageName(i) == uniqueName_)
+				return i;
+		}
+		return npos;
+	}
+
+	// Text of the message in the language, empty if the message has none:
+	auto text(std::size_t message_, std::size_t language_) const -> std::string_view
+	{
+		return string(texts[message_ * header->languageCount + language_]);
+	}
+
+	auto text(std::string_view uniqueName_, std::size_t language_) const -> std::string_view
+	{
+		std::size_t message = find(uniqueName_);
+		return (message == npos || language_ >= languageCount()) ? std::string_view() : text(message, language_);
+	}
+
+private:
+	auto string(CatalogString const& str_) const -> std::string_view
+	{
+		if (str_.offset == CatalogString::NoString)
+			return {};
+		return std::string_view(blob + str_.offset, str_.length);
+	}
+
+	CatalogHeader const*	header		= nullptr;
+	CatalogLanguage const*	languages	= nullptr;
+	std::uint32_t const*	buckets		= nullptr;
+	CatalogMessage const*	index		= nullptr;
+	CatalogString const*	texts		= nullptr;
+	char const*				blob		= nullptr;
+};
+
+// Catalog file mapped into memory for the lifetime of the object.
+class MappedChatCatalog
+{
+public:
+	// Returns nullptr when the file can't be mapped or is not a valid catalog:
+	static auto open(std::string const& path_) -> std::shared_ptr<MappedChatCatalog const>
+	{
+		std::shared_ptr<MappedChatCatalog> mapped(new MappedChatCatalog());
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path_.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		{
+			mapped->mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapped->mapping)
+				mapped->data = MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+			mapped->size = static_cast<std::size_t>(size.QuadPart);
+		}
+		CloseHandle(file);
+#else
+		int fd = ::open(path_.c_str(), O_RDONLY);
+		if (fd < 0)
+			return nullptr;
+
+		struct stat st;
+		if (::fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr != MAP_FAILED)
+			{
+				mapped->data = addr;
+				mapped->size = static_cast<std::size_t>(st.st_size);
+			}
+		}
+		::close(fd);
+#endif
+
+		if (!mapped->data)
+			return nullptr;
+
+		mapped->view = ChatCatalog::fromBytes(mapped->data, mapped->size);
+		if (!mapped->view.valid())
+			return nullptr;
+		return mapped;
+	}
+
+	~MappedChatCatalog()
+	{
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+#else
+		if (data)
+			::munmap(data, size);
+#endif
+	}
+
+	MappedChatCatalog(MappedChatCatalog const&)				= delete;
+	MappedChatCatalog& operator=(MappedChatCatalog const&)	= delete;
+
+	auto catalog() const -> ChatCatalog const&	{ return view; }
+
+private:
+	MappedChatCatalog() = default;
+
+	ChatCatalog		view;
+	void*			data	= nullptr;
+	std::size_t		size	= 0;
+#ifdef _WIN32
+	HANDLE			mapping	= nullptr;
+#endif
+};
+
+// Current catalog of a server, replaceable while other threads read it.
+// The new catalog file should be renamed over the old one (samp-ct does that),
+// a file that is rewritten in place can't be safely mapped.
+class ChatCatalogHandle
+{
+public:
+	// Maps the file and publishes it atomically.
+	// Returns false and keeps the current catalog when the file is not a valid catalog.
+	auto reload(std::string const& path_) -> bool
+	{
+		auto mapped = MappedChatCatalog::open(path_);
+		if (!mapped)
+			return false;
+
+		std::atomic_store(&current, std::move(mapped));
+		return true;
+	}
+
+	// Keeps its catalog mapped even if reload() replaces it meanwhile (nullptr before the first reload()):
+	auto get() const -> std::shared_ptr<MappedChatCatalog const>
+	{
+		return std::atomic_load(&current);
+	}
+
+private:
+	std::shared_ptr<MappedChatCatalog const> current;
+};
+
+}
@@ -1,19 +1,297 @@
 #include <fmt/format.h>
 #include <fmt/compile.h>
 #include <nlohmann/json.hpp>
+#include "ChatCatalog.hpp"
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <cstdint>
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <array>
+#include <memory>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
+#include <optional>
+#include <tuple>
+#include <cerrno>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	#include <psapi.h>
+	#ifdef _MSC_VER
+		#pragma comment(lib, "psapi.lib")
+	#endif
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/uio.h>
+	#include <sys/resource.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#ifdef __linux__
+		#include <sys/inotify.h>
+	#endif
+#endif
+
+// Vectorized scan of string literal texts, see findLiteralSpecial():
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SAMP_CT_SSE2
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#define SAMP_CT_NEON
+	#include <arm_neon.h>
+#endif
 
 using json = nlohmann::json;
 
 struct AppOptions;
+struct CliOptions;
+class MessageCache;
+class OutputSink;
+class Codepage;
+class IdRegistry;
+class MessageValidator;
+
+// Languages of the project ("languages" array), resolved once into a dense table sorted by id.
+class LanguageTable
+{
+public:
+	struct Language
+	{
+		std::string id;
+		std::string name;
+
+		// Index of the language in generated arrays, for example:
+		// "static_cast<int>(game::Languages::English)" (empty without "languageEnum"),
+		// or its position in the table when "languages" selects a subset, for example: "1",
+		// or its "idRegistry" id without both of them
+		std::string index;
+
+		// Enumerator of the language, for example: "game::Languages::English" (empty without "languageEnum")
+		std::string enumerator;
+	};
+
+	LanguageTable() = default;
+	LanguageTable(AppOptions const& opts_, json const& languages_);
+
+	// Binary search by id, nullptr for unknown languages:
+	auto find(std::string_view id_) const -> Language const*;
+
+	auto size() const -> size_t								{ return languages.size(); }
+	// Length of text arrays when "idRegistry" or a "languages" subset fixes the indexes (0 - arrays hold the texts of the message):
+	auto slots() const -> size_t							{ return slotCount; }
+	auto operator[](size_t denseId_) const -> Language const&	{ return languages[denseId_]; }
+	auto denseId(Language const& lang_) const -> size_t		{ return static_cast<size_t>(&lang_ - languages.data()); }
+
+private:
+	std::vector<Language>	languages;
+	size_t					slotCount = 0;
+};
+
+// Called for every element of the "chatMessages" array.
+using ChatMessageVisitor = std::function<void(LanguageTable const& langs_, json const& message_)>;
+
+// Chat message with texts in every language, used by emission modes that need the whole project.
+struct ChatMessage
+{
+	std::string uniqueName;
+	std::string comment;
+
+	// Language id -> "processed" text, in JSON object order
+	std::vector< std::pair<std::string, std::string> > texts;
+};
+
+// "processed" text parsed as a fmt format string, see "formatMetadata".
+struct FormatString
+{
+	struct Segment
+	{
+		std::string literal;	// Text before the argument, with "{{" and "}}" unescaped
+		int			arg;		// -1 for the trailing literal
+		std::string	spec;		// Format spec after ':'
+	};
+
+	size_t					argCount = 0;
+	std::vector<Segment>	segments;
+};
+
+struct ChatProject
+{
+	LanguageTable				langs;
+	std::vector<ChatMessage>	messages;
+};
+
+// Counters and phase times collected by "--stats".
+struct GenerationStats
+{
+	// Wall time of each phase in seconds.
+	// With "--stream" parsing happens during emission and is included in "emit".
+	double readOptions	= 0;
+	double readInput	= 0;
+	double parse		= 0;
+	double emit			= 0;
+	double write		= 0;
+
+	size_t bytesRead		= 0;
+	size_t bytesGenerated	= 0;
+	size_t bytesWritten		= 0;
+	size_t filesWritten		= 0;
+	size_t filesUnchanged	= 0;
+	size_t messages			= 0;
+	size_t cachedMessages	= 0;
+	size_t unusedMessages	= 0;
+	size_t languages		= 0;
+
+	// Message with the longest generated code:
+	std::string	largestMessage;
+	size_t		largestMessageSize = 0;
+
+	// Capacity growths of the buffers messages are formatted into, counted once per message that grew one:
+	size_t contentReallocations	= 0;
+	// Capacity growths of generated files built in memory, every write is checked
+	// (0 when the output is written straight to a file):
+	size_t outputReallocations	= 0;
+
+	auto countMessage(json const& value_, size_t size_) -> void
+	{
+		++messages;
+		if (size_ <= largestMessageSize)
+			return;
+
+		largestMessageSize = size_;
+		auto it = value_.is_object() ? value_.find("uniqueName") : value_.end();
+		largestMessage = (it != value_.end() && it->is_string()) ? it->get<std::string>() : std::string{};
+	}
+
+	auto merge(GenerationStats const& other_) -> void
+	{
+		messages				+= other_.messages;
+		cachedMessages			+= other_.cachedMessages;
+		contentReallocations	+= other_.contentReallocations;
+		if (other_.largestMessageSize > largestMessageSize)
+		{
+			largestMessageSize	= other_.largestMessageSize;
+			largestMessage		= other_.largestMessage;
+		}
+	}
+};
+
+// State shared by the generation functions of a single run.
+struct GenerationContext
+{
+	MessageCache*		cache	= nullptr;
+	GenerationStats*	stats	= nullptr;
+	size_t				jobs	= 1;
+
+	// Receives uniqueNames of messages skipped by "usedMessagesFile" and "usageScanPaths", in project order:
+	std::vector<std::string>*	unusedMessages = nullptr;
+
+	// Checks the project when "validate" is enabled:
+	MessageValidator*			validator = nullptr;
+};
+
+// A generated file with its full contents.
+struct OutputFile
+{
+	std::string path;
+	std::string contents;
+
+	// Write a temporary file and rename it over the old one, so readers that
+	// map the file at runtime never see a partially written file.
+	bool replaceAtomically = false;
+};
 
 auto readArgs(int argc, char* argv[])									-> std::vector< std::string_view >;
-auto readFileSequentially(std::istream& inputStream_)					-> std::string;
-auto readAppOptions(AppOptions& opts_, std::istream& inputStream_)		-> void;
-auto parseChatJson(AppOptions const& opts_, std::istream& inputFile_)	-> std::string;
+auto readCliOptions(CliOptions& cli_, std::vector< std::string_view > const& args_) -> void;
+auto readAppOptions(AppOptions& opts_, std::string_view fileContents_)	-> void;
+auto readUsedMessages(AppOptions& opts_)								-> void;
+auto applyCliOptions(AppOptions& opts_, CliOptions const& cli_)			-> void;
+auto scanIdentifiers(std::vector<std::string> const& files_, std::unordered_set<std::string>& identifiers_) -> void;
+auto parseChatJson(AppOptions const& opts_, std::string_view fileContents_, GenerationContext const& ctx_ = {}) -> std::string;
+auto writeChatJson(AppOptions const& opts_, std::string_view fileContents_, OutputSink& output_, GenerationContext const& ctx_ = {}) -> void;
+auto streamChatJson(AppOptions const& opts_, std::string_view fileContents_, OutputSink& output_, GenerationContext const& ctx_ = {}) -> void;
+auto shardChatJson(AppOptions const& opts_, std::string_view fileContents_, bool streaming_, std::string_view outputPath_, GenerationContext const& ctx_ = {}) -> std::vector<OutputFile>;
+auto visitChatJson(AppOptions const& opts_, std::string_view fileContents_, bool streaming_, ChatMessageVisitor const& visitor_, GenerationContext const& ctx_ = {}) -> LanguageTable;
+auto visitChatDocument(AppOptions const& opts_, json& j, ChatMessageVisitor const& visitor_, GenerationContext const& ctx_ = {}) -> LanguageTable;
+auto filterUsedMessages(AppOptions const& opts_, ChatMessageVisitor const& visitor_, GenerationContext const& ctx_) -> ChatMessageVisitor;
+auto selectLanguages(AppOptions const& opts_, json& message_)			-> void;
+auto formatChatMessages(AppOptions const& opts_, LanguageTable const& langs_, std::vector<json const*> const& messages_, GenerationContext const& ctx_, OutputSink& output_) -> void;
+auto collectChatProject(AppOptions const& opts_, std::string_view fileContents_, bool streaming_, GenerationContext const& ctx_ = {}) -> ChatProject;
+auto generateOutputFiles(AppOptions const& opts_, CliOptions const& cli_, std::string_view fileContents_, std::string_view outputPath_, GenerationContext const& ctx_) -> std::vector<OutputFile>;
+auto generateProject(AppOptions const& opts_, CliOptions const& cli_, std::string_view inputPath_, std::string_view outputPath_, GenerationContext ctx_, GenerationStats& stats_) -> bool;
+auto runBatch(CliOptions const& cli_)									-> bool;
+auto runWatch(CliOptions const& cli_)									-> void;
+auto writeOutputFile(OutputFile const& file_)							-> bool;
+auto writeOutputFilesIncremental(std::vector<OutputFile> const& files_, std::string const& manifestPath_, GenerationStats* stats_ = nullptr) -> bool;
+auto printStats(GenerationStats const& stats_)							-> void;
+auto statsToJson(GenerationStats const& stats_)							-> json;
+auto hashBytes(std::string_view bytes_, uint64_t hash_ = 14695981039346656037ull) -> uint64_t;
+auto peakMemoryUsage()													-> size_t;
+auto runBenchmark(AppOptions const& opts_, CliOptions const& cli_)		-> bool;
+auto checkOutputEquivalence(AppOptions const& opts_, std::string_view fileContents_, size_t jobs_) -> bool;
+auto runCompileCostReport(AppOptions const& opts_, CliOptions const& cli_) -> void;
+auto generateSyntheticProject(CliOptions const& cli_, uint32_t seed_)	-> std::string;
+
+auto appendPrologue(AppOptions const& opts_, std::string& output_)		-> void;
+auto appendIncludes(AppOptions const& opts_, std::string& output_)		-> void;
+auto appendNamespaceBegin(AppOptions const& opts_, std::string& output_)	-> void;
+auto appendEpilogue(AppOptions const& opts_, std::string& output_)		-> void;
+auto appendChatMessage(AppOptions const& opts_, LanguageTable const& langs_, json const& value_, std::string& output_) -> void;
+auto appendNameLookup(AppOptions const& opts_, std::vector<std::string> const& names_, std::string& output_) -> void;
+auto appendRuntimeApi(AppOptions const& opts_, LanguageTable const& langs_, std::vector<std::string> const& names_, std::string& output_) -> void;
+auto appendLanguageIndex(AppOptions const& opts_, LanguageTable const& langs_, std::string& output_) -> void;
+auto assignMessageIds(AppOptions const& opts_, std::vector<std::string>& names_) -> void;
+auto appendNumber(size_t value_, std::string& output_)					-> void;
+auto appendLiteralText(AppOptions const& opts_, std::string_view text_, std::string_view uniqueName_, std::string& output_, Codepage const* codepage_ = nullptr) -> void;
+auto appendCommentText(std::string_view text_, std::string& output_)	-> void;
+auto literalBytes(AppOptions const& opts_, std::string const& text_, Codepage const* codepage_ = nullptr, std::string_view uniqueName_ = {}, std::string_view langId_ = {}) -> std::string;
+auto languageCodepage(AppOptions const& opts_, std::string_view langId_)	-> Codepage const*;
+auto encodeText(Codepage const& codepage_, std::string_view text_, std::string_view uniqueName_, std::string& output_) -> void;
+auto escapeHighBytes(std::string& output_, size_t begin_)				-> void;
+auto findLiteralSpecial(std::string_view text_, size_t pos_ = 0)		-> size_t;
+auto parseFormatString(std::string_view text_, std::string_view uniqueName_, std::string_view langId_) -> FormatString;
+auto formatArgType(std::string_view type_)								-> std::string;
+auto inferArgType(std::string_view spec_)								-> std::string_view;
+auto chatMessageName(json const& value_)								-> std::string_view;
+auto messageText(json const& msgContent_, char const* field_, std::string_view uniqueName_, std::string_view langId_) -> std::string const&;
+auto emitChatMessage(AppOptions const& opts_, LanguageTable const& langs_, json const& value_, std::string& output_, MessageCache* cache_, GenerationStats* stats_) -> void;
+auto emitStringTable(AppOptions const& opts_, ChatProject const& project_) -> std::string;
+auto emitCatalog(AppOptions const& opts_, ChatProject const& project_)	-> std::string;
+auto emitExtern(AppOptions const& opts_, ChatProject const& project_, std::string_view outputPath_) -> std::vector<OutputFile>;
+
+enum class EmitMode
+{
+	Classes,
+	StringTable,
+	Catalog,
+	Extern
+};
+
+enum class ShardMode
+{
+	None,
+	Count,
+	Prefix,
+	Category
+};
 
 struct AppOptions
 {
@@ -62,270 +340,5657 @@ struct AppOptions
 	// Should use #pragma once?
 	// This shouldn't be disabled unless you really know what you're doing.
 	bool usePragmaOnce = true;
+
+	// JSON field: "emitMode"
+	// How chat messages are emitted (optional):
+	// "classes" (default) - one ChatMessageBase subclass per message with a constexpr text array,
+	// "stringTable" - one string blob per language and an (offset, length) index table,
+	//                 each message becomes an inline constexpr ChatMessage id constant,
+	// "catalog" - a memory-mappable binary file with languages, a hashed message index
+	//             and a string blob, read at runtime with ChatCatalog.hpp,
+	// "extern" - a header with "extern ChatMessage const <name>;" declarations and
+	//            "<output>.cpp" with all definitions and texts, so including the header stays cheap.
+	EmitMode emitMode = EmitMode::Classes;
+
+	// JSON field: "deduplicateStrings"
+	// Pool identical texts of all messages and languages into one string blob?
+	// Used with "emitMode": "stringTable" and "catalog".
+	bool deduplicateStrings = false;
+
+	// JSON field: "shareSuffixes"
+	// Let texts that end another text point into it (implies "deduplicateStrings")?
+	// Used with "emitMode": "stringTable" and "catalog".
+	bool shareSuffixes = false;
+
+	// JSON field: "shardBy"
+	// Splits generated code into several headers (optional):
+	// "none" (default), "count", "prefix" or "category".
+	// The output file becomes an umbrella header that includes
+	// "<output>_base<ext>" and one "<output>_<shard><ext>" per shard.
+	ShardMode shardBy = ShardMode::None;
+
+	// JSON field: "shardSize"
+	// Maximum number of chat messages per shard, used with "shardBy": "count".
+	size_t shardSize = 1000;
+
+	// JSON field: "shardPrefixSeparator"
+	// End of the uniqueName prefix, used with "shardBy": "prefix".
+	// For example: "_" puts "Gm_Kick" into the "Gm" shard.
+	std::string shardPrefixSeparator = "_";
+
+	// JSON field: "nameLookup"
+	// Emit a constexpr minimal perfect hash table and findMessage(uniqueName),
+	// which returns the message id and its text array (nullptr for unknown names)?
+	// Used with "emitMode": "classes".
+	bool nameLookup = false;
+
+	// JSON field: "runtimeApi"
+	// Emit a MessageId enum, a language-major table with the texts of all messages,
+	// text(id, language) and renderForPlayers(), which formats a broadcast once per language?
+	// Languages are indexed like "text" arrays. Used with "emitMode": "classes".
+	bool runtimeApi = false;
+
+	// JSON field: "formatMetadata"
+	// Parse every "processed" text as a fmt format string at generation time
+	// and emit its literal segments, argument ids and format specs as constexpr
+	// "format" data next to "text"? Languages of a message must use the same number of arguments.
+	// SAMP color codes like "{FF0000}" are kept as literal text.
+	// Used with "emitMode": "classes".
+	bool formatMetadata = false;
+
+	// JSON field: "escapeStrings"
+	// Treat "processed" texts as raw text and escape quotes, backslashes and control characters?
+	// By default texts are pasted as string literal bodies, so escape sequences written
+	// in the designer keep working, and texts that would break the literal are reported as errors.
+	bool escapeStrings = false;
+
+	// JSON field: "languageEncodings"
+	// Target codepage of the client for each language id (optional):
+	// For example: { "pl": "windows-1250", "ru": "windows-1251" }
+	// Texts of these languages are transcoded from UTF-8 at generation time and every
+	// non-ASCII byte is written as an octal escape, so the generated bytes can be sent as they are.
+	// Supported: windows-1250, 1251, 1252, 1253, 1254 and 1257.
+	std::map< std::string, std::string, std::less<> > languageEncodings;
+
+	// JSON field: "languages"
+	// Language ids kept in this build (optional, overridden by "--languages"):
+	// For example: [ "en", "pl" ]
+	// Other languages are dropped from every message and the language table, and the kept ones
+	// are renumbered densely in id order, so text arrays hold only the selected languages.
+	// With "languageEnum" the generated languageIndex(<enum>) maps enum values to these positions.
+	std::vector< std::string > languages;
+
+	// JSON field: "languageFallbacks"
+	// Languages tried in order when a message has no text in a language (optional):
+	// For example: { "pl": [ "en" ], "ru": [ "uk", "en" ] }
+	// Missing texts are copied from the first fallback the message has, at generation time.
+	// Applies to the "languages" selection, or to the keys of this object without it.
+	std::map< std::string, std::vector< std::string >, std::less<> > languageFallbacks;
+
+	// JSON field: "validate"
+	// Check the whole project before generating code and report every problem at once, with JSON paths:
+	// missing or mistyped keys, uniqueNames and language names that are not C++ identifiers,
+	// duplicate uniqueNames, languages missing from "languages", invalid format strings,
+	// different numbers of format arguments across languages and texts longer than 144 bytes
+	// (SAMP's chat line) without their arguments, in the codepage of "languageEncodings".
+	bool validate = false;
+
+	// JSON field: "idRegistry"
+	// JSON file with append-only numeric ids of uniqueNames and language ids (optional):
+	// { "messages": { "Welcome": 0, "Gm_Kick": 1 }, "languages": { "en": 0, "pl": 1 } }
+	// New names get the next free id and the file is updated after the run, removed names keep theirs.
+	// MessageId values, ids of "nameLookup" and "stringTable" messages, and language indexes
+	// (without "languageEnum" and "languages") then survive added messages and languages.
+	std::string idRegistryFile;
+
+	// JSON field: "textInfo"
+	// Emit a constexpr "info" array next to "text" with the length in bytes of every text
+	// and whether it has fmt placeholders, so texts without arguments can be sent without formatting?
+	// Used with "emitMode": "classes".
+	bool textInfo = false;
+
+	// JSON field: "typedFormat"
+	// Emit a static formatTo(language, buffer, args...) into every class, which writes literal
+	// segments and arguments straight into an internal::ChatBuffer of SAMP's 144 character limit,
+	// without parsing the format string or allocating at runtime?
+	// Argument types come from the "args" array of a chat message, e.g. [ "string", "int" ],
+	// or are inferred from format specs ("{:d}" - int, "{:.2f}" - double, "{:s}" - string),
+	// the rest become template parameters. Used with "emitMode": "classes".
+	bool typedFormat = false;
+
+	// JSON field: "usedMessagesFile"
+	// Text file with the uniqueNames referenced by the game code, one per line (optional).
+	// Empty lines and lines starting with '#' are ignored.
+	std::string usedMessagesFile;
+
+	// JSON field: "usageScanPaths"
+	// Source directories (searched recursively) and files of the game code (optional).
+	// Every identifier in C and C++ sources counts as a reference, so uses through
+	// "using namespace" or macros are kept as well.
+	std::vector< std::string > usageScanPaths;
+
+	// JSON field: "unusedMessagesReport"
+	// File that receives the uniqueNames of skipped messages, one per line (optional).
+	std::string unusedMessagesReport;
+
+	// Referenced uniqueNames, resolved from "usedMessagesFile" and "usageScanPaths" by readAppOptions.
+	// When set, only these messages are emitted (nullptr - all messages).
+	std::shared_ptr< std::unordered_set<std::string> const > usedMessages;
+
+	// Loaded from "idRegistryFile" by readAppOptions, shared by projects that use the same options.
+	std::shared_ptr< IdRegistry > idRegistry;
 };
 
-constexpr std::string_view Text = "Hello, World, {}";
+struct CliOptions
+{
+	// Positional arguments: [options file name] [input file name] [output file name]
+	std::vector< std::string_view > files;
 
-int main(int argc, char* argv[])
+	// Flag: "--stream"
+	// Parse the input file with a SAX parser and write each chat message
+	// as soon as its object closes, instead of building a full JSON document.
+	// Peak memory then depends on the largest single message, not on the whole project.
+	bool streaming = false;
+
+	// Flag: "--incremental"
+	// Write output files only when their contents actually changed.
+	// Hashes of written files are stored in "<output file name>.manifest",
+	// so unchanged files keep their modification time and don't trigger rebuilds.
+	// Generated code of each message is reused from "<output file name>.cache".
+	bool incremental = false;
+
+	// Flag: "--jobs N"
+	// Number of threads that format chat messages (0 - one per hardware thread).
+	// Output is byte-for-byte identical to a single-threaded run.
+	// Streaming mode always formats on a single thread.
+	size_t jobs = 1;
+
+	// Flags: "--stats", "--stats-json FILE"
+	// Report phase times (readAppOptions, input read, json::parse, message emission, output write),
+	// byte, message and language counts, the largest message and buffer reallocations.
+	// "--stats" prints a summary, "--stats-json" writes the same data as JSON to FILE.
+	bool				stats = false;
+	std::string_view	statsJson;
+
+	// Flag: "--batch MANIFEST"
+	// Process every project listed in the MANIFEST JSON file in a single invocation:
+	// [ [ "options file name", "input file name", "output file name" ], ... ]
+	// Relative paths are resolved against the directory of the manifest.
+	// Projects run in parallel on "--jobs" threads, each is formatted on a single thread.
+	// Options files with identical contents are parsed only once.
+	std::string_view batch;
+
+	// Flag: "--watch"
+	// Keep running and regenerate the output whenever the input or options file changes.
+	// Options, the per-message cache and the generated code of unchanged messages stay in memory,
+	// so only edited messages are formatted again.
+	bool watch = false;
+
+	// Flag: "--bench"
+	// Generate synthetic UX Designer projects and time every phase of the classes
+	// pipeline: read, json::parse, language resolution, message formatting and output write.
+	// Positional arguments are optional: [options file name]
+	bool bench = false;
+
+	// Flags: "--bench-messages N", "--bench-languages N", "--bench-length MIN:MAX", "--bench-runs N"
+	// Shape of the synthetic project and number of runs (the fastest run is reported).
+	size_t benchMessages	= 10'000;
+	size_t benchLanguages	= 4;
+	size_t benchMinLength	= 16;
+	size_t benchMaxLength	= 128;
+	size_t benchRuns		= 3;
+
+	// Flags: "--bench-baseline FILE", "--bench-tolerance PERCENT"
+	// Throughput regression check: the bench fails (exit code 1) when messages/s fall or peak RSS
+	// grows by more than PERCENT (default 10) against FILE. A missing FILE is written from this run.
+	// Every bench also checks that "--jobs", "--stream" and the incremental cache produce
+	// the same bytes as the single-threaded run.
+	std::string_view	benchBaseline;
+	double				benchTolerance = 10.0;
+
+	// Flag: "--report-compile-cost FILE"
+	// Estimate what the generated "classes" code costs the C++ compiler instead of generating it:
+	// per message and per shard ("shardBy") the constexpr evaluations, literal bytes,
+	// FMT_COMPILE instantiations and text array sizes, written as JSON to FILE.
+	// Positional arguments: [options file name] [input file name]
+	std::string_view compileCostReport;
+
+	// Flag: "--languages ID,ID..."
+	// Replaces the "languages" option of every options file, e.g. "--languages en,pl".
+	std::vector< std::string > languages;
+};
+
+// Measures wall time of consecutive phases.
+class Stopwatch
 {
-	auto args = readArgs(argc, argv);
-	
-	if (args.size() < 4)
+public:
+	// Seconds since construction or the previous lap:
+	auto lap() -> double
 	{
-		std::cout << "Usage: " << args[0] << " [options file name] [input file name] [output file name]\n";
-		return 0;
+		auto now = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(now - last).count();
+		last = now;
+		return seconds;
 	}
 
-	std::ifstream optsFile(args[1].data());
-	if (!optsFile.is_open())
-	{
-		fmt::print("Error: could not open \"{}\" options file for reading.", args[1]);
-		return 0;
-	}
+private:
+	std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+};
+
+// Destination of generated code, written front to back.
+class OutputSink
+{
+public:
+	virtual ~OutputSink() = default;
+
+	virtual auto write(std::string_view data_) -> void = 0;
+};
 
-	std::ifstream inFile(args[2].data());
-	if (!inFile.is_open())
+// Appends generated code to a string.
+// Counts every growth of the string's capacity into reallocations_ when it is given.
+class StringSink : public OutputSink
+{
+public:
+	explicit StringSink(std::string& output_, size_t* reallocations_ = nullptr)
+		: output(output_), reallocations(reallocations_)
 	{
-		fmt::print("Error: could not open \"{}\" input file for reading.", args[2]);
-		return 0;
 	}
 
-	std::ofstream outFile(args[3].data());
-	if (!outFile.is_open())
+	auto write(std::string_view data_) -> void override
 	{
-		fmt::print("Error: could not open \"{}\" file for writing.", args[3]);
-		return 0;
+		size_t capacity = output.capacity();
+		output += data_;
+		if (reallocations && output.capacity() != capacity)
+			++*reallocations;
 	}
 
-	AppOptions opts;
-	readAppOptions(opts, optsFile);
+private:
+	std::string&	output;
+	size_t*			reallocations;
+};
 
-	outFile << parseChatJson(opts, inFile);
-}
+// Writes generated code straight to a file through a large buffer.
+// Pieces that do not fit into the buffer are not copied, they are written
+// together with the buffered bytes in a single vectored write.
+class FileSink : public OutputSink
+{
+public:
+	explicit FileSink(std::string_view path_);
+	~FileSink() override;
 
-using LangMap = std::map<std::string, std::string>;
+	FileSink(FileSink const&)				= delete;
+	FileSink& operator=(FileSink const&)	= delete;
 
-std::string parseChatJson(AppOptions const& opts_, std::istream& inputFile_)
-{
-	std::string fileContents = readFileSequentially(inputFile_);
+	auto isOpen() const -> bool				{ return opened; }
+	auto bytesWritten() const -> size_t		{ return written + used; }
 
-	json j = json::parse(fileContents);
+	auto write(std::string_view data_) -> void override;
+	auto close() -> void;
 
-	std::string chatContent;
-	chatContent.reserve(1 * 1024 * 1024);
-	{
-		if (j.type() != json::value_t::object)
-			throw std::runtime_error("Could not parse JSON file - value is not an object.");
+private:
+	auto writeAll(std::string_view first_, std::string_view second_) -> void;
 
-		LangMap langs;
+	static constexpr size_t BufferSize = 1 * 1024 * 1024;
 
-		// Read languages:
-		{
-			auto it = j.find("languages");
-			if (it == j.end() || it->type() != json::value_t::array)
-				throw std::runtime_error("Could not parse JSON file - \"languages\" value is not an array.");
+	std::unique_ptr<char[]>	buffer;
+	size_t					used		= 0;
+	size_t					written		= 0;
+	bool					opened		= false;
 
-			for (auto const& lang : it->items())
-			{
-				auto const& val = lang.value();
-				if (val.type() != json::value_t::object)
-					throw std::runtime_error("Could not parse JSON file - language content is not an object.");
+#ifdef _WIN32
+	HANDLE					file		= INVALID_HANDLE_VALUE;
+#else
+	int						fd			= -1;
+#endif
+};
 
-				std::string id		= val["id"].get<std::string>();
-				std::string name	= val["name"].get<std::string>();
-				langs[id] = name;
-			}
-		}
+// Read-only contents of an input file.
+// Regular files are memory-mapped, everything else (pipes, character devices)
+// is read whole from the already opened file, so a FIFO is opened only once.
+class InputFile
+{
+public:
+	enum class Mode
+	{
+		Map,
+		// Files that editors may truncate while "--watch" reads them, a mapping of a file that shrinks raises SIGBUS:
+		Read
+	};
 
-		// Read chat messages:
-		{
-			auto it = j.find("chatMessages");
-			if (it == j.end() || it->type() != json::value_t::array)
-				throw std::runtime_error("Could not parse JSON file - \"chatMessages\" field not exists or is not an array.");
-			
-			for(auto const& [key, value] : it->items())
-			{
-				if (value.type() != json::value_t::object)
-					continue;
+	explicit InputFile(std::string_view path_, Mode mode_ = Mode::Map);
+	~InputFile();
 
-				if (!value.contains("uniqueName") || !value.contains("content"))
-					continue;
-				std::string uniqueName = value["uniqueName"].get<std::string>();
+	InputFile(InputFile const&)				= delete;
+	InputFile& operator=(InputFile const&)	= delete;
 
-				std::string comment;
-				std::string langContent;
-				langContent.reserve(4 * 1024);
-				size_t langIndex = 0;
-				for (auto const& [langId, msgContent] : value["content"].items())
-				{
-					// Load first comment-version of a message as a comment:
-					if (comment.empty())
-						comment = msgContent["comment"].get<std::string>();
+	auto isOpen() const -> bool				{ return opened; }
+	auto contents() const -> std::string_view	{ return view; }
 
-					langContent += "\t\tresult[";
-					if (opts_.languageEnum.empty())
-						langContent += std::to_string(langIndex);
-					else
-						langContent += "static_cast<int>(" + opts_.languageEnum + "::" + langs[langId] + ")";
+private:
+#ifdef _WIN32
+	auto readAll(HANDLE file_) -> void;
+#else
+	auto readAll(int fd_, size_t sizeHint_) -> void;
+#endif
 
-					langContent += "] = ";
+	std::string_view	view;
+	std::string			buffer;		// Used only when the file is not mapped
+	bool				opened		= false;
 
-					if (opts_.useCompileMacro)
-						langContent += "FMT_COMPILE(";
+#ifdef _WIN32
+	HANDLE				file		= INVALID_HANDLE_VALUE;
+	HANDLE				mapping		= nullptr;
+#endif
+	void const*			mapped		= nullptr;
+	size_t				mappedSize	= 0;
+};
 
-					langContent += '"';
-					langContent += msgContent["processed"].get<std::string>();
-					langContent += '"';
+// Single-byte Windows codepage of SAMP clients, see "languageEncodings".
+class Codepage
+{
+public:
+	// Accepts "windows-1250" and "cp1250" forms, nullptr for unsupported codepages:
+	static auto find(std::string_view name_) -> Codepage const*;
 
-					if (opts_.useCompileMacro)
-						langContent += ')';
+	auto name() const -> std::string_view		{ return codepageName; }
 
-					langContent += ";\n";
-					++langIndex;
-				}
-					
-				fmt::format_to(std::back_inserter(chatContent),
-						"// \"{}\"\n"
-						"class \n\t: public internal::ChatMessageBase\n"
-						"{{\n"
-						"\tstatic constexpr auto generateContent = []\n\t{{\n"
-						"\t\tstd::array<std::string_view, {}> result;\n"
-						// Each language will be appended here
-						"{}"
-						// End of languages
-						"\t\treturn result;\n"
-						"\t}};\n"
-						"public:\n"
-						"\tstatic constexpr auto text = generateContent();\n"
-						"}} inline constexpr {};\n\n"
-						"",
-						comment,
-						langIndex,
-						langContent,
-						uniqueName
-					);
+	// Appends UTF-8 text_ in this codepage, ASCII is copied as is.
+	// Returns the position of the first character that has no byte in the codepage
+	// or is not valid UTF-8, npos when the whole text was encoded.
+	auto encode(std::string_view text_, std::string& output_) const -> size_t;
 
-			}
-		}
-	}
+private:
+	Codepage(std::string_view name_, char16_t const (&upper_)[128]);
 
-	std::string output;
-	output.reserve(1 * 1024 * 1024);
+	std::string_view									codepageName;
+	std::vector< std::pair<char32_t, unsigned char> >	bytes;		// Code points of bytes 0x80-0xFF, sorted
+};
 
-	// Append pragma once
-	if (opts_.usePragmaOnce)
-		output += "#pragma once\n\n";
+// Generated code of every chat message from the previous run, keyed by uniqueName.
+// Messages with unchanged content reuse their code instead of being formatted again.
+// File layout (native byte order):
+// "SCTC" | u32 version | u64 options hash | u32 count | count * { u32 size, uniqueName, u64 content hash, u32 size, code }
+class MessageCache
+{
+public:
+	MessageCache(AppOptions const& opts_, std::string path_);
 
-	// Append pch
-	if (!opts_.pch.empty())
-	{
-		output += "#include ";
-		output += opts_.pch;
-		output += '\n';
-	}
+	// Returns true when the code was reused:
+	auto append(LanguageTable const& langs_, json const& value_, std::string& output_) -> bool;
+	auto save() -> bool;
 
-	// Append header files
-	for (auto const& headerFile : opts_.headerFiles)
+	// Makes the messages of the current run the cache of the next one, in memory.
+	// rollback() drops them instead, e.g. after a failed run.
+	auto rotate() -> void;
+	auto rollback() -> void;
+
+private:
+	struct Entry
 	{
-		output += "#include ";
-		output += headerFile;
-		output += '\n';
-	}
+		uint64_t			hash;
+		std::string_view	code;
+	};
 
-	output += "\n\n";
+	auto contentHash(LanguageTable const& langs_, std::string const& uniqueName_, json const& content_) const -> uint64_t;
 
-	// Append namespace
-	if (!opts_.ns.empty())
-	{
-		output += "namespace ";
-		output += opts_.ns;
-		output += "\n{\n\n";
-	}
+	AppOptions const&	opts;
+	std::string			path;
+	uint64_t			optionsHash;
 
-	output += "namespace internal {\nstruct ChatMessageBase {};\n}\n\n";
-	output += chatContent;
+	std::unique_ptr<InputFile>						file;
+	std::unordered_map<std::string_view, Entry>		previous;
+	std::vector< std::pair<std::string, Entry> >	current;
+	std::deque<std::string>							generated;	// Owns code of cache misses
+	std::mutex										currentMutex;	// append() is called from formatChatMessages workers
+};
 
-	// Append namespace end
-	if (!opts_.ns.empty())
-		output += "\n}\n";
+// Stable ids of uniqueNames and language ids, see "idRegistry".
+// Ids are only ever added, so tables indexed by them keep their layout across runs.
+class IdRegistry
+{
+public:
+	explicit IdRegistry(std::string path_);
 
-	return output;
-}
+	// Id of the name, a new name gets the next free id:
+	auto messageId(std::string_view uniqueName_) -> size_t;
+	auto languageId(std::string_view langId_) -> size_t;
 
+	// Number of ids ever given out, the length of tables indexed by them:
+	auto messageCount() -> size_t;
+	auto languageCount() -> size_t;
 
-////////////////////////////////////////////////
-auto readArgs(int argc, char* argv[]) -> std::vector< std::string_view >
-{
-	auto args = std::vector< std::string_view >{};
-	args.reserve(argc);
-	for(int i = 0; i < argc; ++i)
-		args.push_back(argv[i]);
+	// Writes the file when ids were added since it was read or saved:
+	auto save() -> bool;
 
-	return args;
-}
+private:
+	struct Ids
+	{
+		std::map< std::string, size_t, std::less<> >	byName;
+		size_t											next = 0;
+	};
 
-////////////////////////////////////////////////
-auto readAppOptions(AppOptions& opts_, std::istream& inputStream_) -> void
+	auto assign(Ids& ids_, std::string_view name_) -> size_t;
+
+	std::string	path;
+	Ids			messages;
+	Ids			languages;
+	bool		changed = false;
+	std::mutex	mutex;	// "--batch" projects with the same options run in parallel
+};
+
+// Problems of a project found by "validate", reported together by report().
+// Parsed documents are checked on "--jobs" threads before anything is emitted.
+// The streaming parser checks every message as it closes and skips the ones with problems.
+class MessageValidator
 {
-	std::string fileContents = readFileSequentially(inputStream_);
+public:
+	explicit MessageValidator(AppOptions const& opts_);
 
-	json j = json::parse(fileContents);
+	// The "languages" array of the project:
+	auto checkLanguages(json const& languages_) -> void;
 
-	if (j.type() != json::value_t::object)
-		throw std::runtime_error("Could not parse options file - value is not an object.");
+	// An element of "chatMessages" at index_, returns false when it has problems:
+	auto checkMessage(json const& message_, size_t index_) -> bool;
 
-	#define READ_OPTION(CppName, CppType, JsonName, JsonType) \
-		if (j.contains(JsonName)) \
-		{ \
-			auto const& val = j[JsonName]; \
-			if (val.type() != json::value_t::JsonType) \
-				throw std::runtime_error("Could not parse options file - \"" JsonName "\" value is not a "#JsonType"."); \
-			opts_.CppName = j[JsonName].get<CppType>(); \
-		}
+	// Every element of "chatMessages":
+	auto checkMessages(json const& messages_, size_t jobs_) -> void;
 
+	// Throws a runtime_error that lists every problem found so far, in project order:
+	auto report() const -> void;
 
-	READ_OPTION(useCompileMacro,	bool, "useCompileMacro",		boolean);
-	READ_OPTION(usePragmaOnce,		bool, "usePragmaOnce",			boolean);
+private:
+	struct Issue
+	{
+		size_t		order;		// 0 for languages, message index + 1 for messages
+		std::string	path;
+		std::string	text;
+	};
 
-	READ_OPTION(languageEnum,		std::string, "languageEnum",	string);
-	READ_OPTION(pch,				std::string, "pch",				string);
-	READ_OPTION(ns,					std::string, "namespace", 		string);
-	READ_OPTION(chatMessageType,	std::string, "chatMessageType",	string);
+	// Language id -> index of the first message that uses it
+	using LanguageUses = std::map< std::string, size_t, std::less<> >;
 
-	// Read header files:
+	// Only reads the options, so it runs on several threads at once:
+	auto checkContent(json const& message_, size_t index_, std::vector<Issue>& issues_, LanguageUses& uses_) const -> void;
+	auto checkName(json const& message_, size_t index_) -> void;
+
+	AppOptions const&							opts;
+	std::vector<Issue>							issues;
+	LanguageUses								languageUses;
+	std::unordered_set<std::string>				languageIds;
+	std::unordered_map<std::string, size_t>		names;
+	bool										seenLanguages = false;
+};
+
+// Waits for changes of a few files.
+// Uses inotify on Linux and directory change notifications on Windows,
+// other systems poll. Changes are confirmed by comparing modification time and size,
+// so events of unrelated files in the same directories are ignored.
+class FileWatcher
+{
+public:
+	explicit FileWatcher(std::vector<std::string> paths_);
+	~FileWatcher();
+
+	FileWatcher(FileWatcher const&)				= delete;
+	FileWatcher& operator=(FileWatcher const&)	= delete;
+
+	// Blocks until at least one file changed, returns indices of the changed files:
+	auto wait() -> std::vector<size_t>;
+
+private:
+	struct Watched
 	{
-		auto headersIt = j.find("headerFiles");
+		std::string							path;
+		std::filesystem::file_time_type		time;
+		uintmax_t							size = 0;
+	};
 
-		if (headersIt != j.end())
+	auto waitForActivity() -> void;
+	auto changedFiles() -> std::vector<size_t>;
+
+	std::vector<Watched>	files;
+
+#ifdef _WIN32
+	std::vector<HANDLE>		handles;
+#elif defined(__linux__)
+	int						fd = -1;
+#endif
+};
+
+constexpr std::string_view Text = "Hello, World, {}";
+
+int main(int argc, char* argv[])
+{
+	auto args = readArgs(argc, argv);
+
+	CliOptions cli;
+	readCliOptions(cli, args);
+
+	if (cli.bench)
+	{
+		AppOptions opts;
+		if (!cli.files.empty())
 		{
-			if (headersIt->type() != json::value_t::array)
-				throw std::runtime_error("Could not parse options file - \"headerFiles\" field not exists or is not an array.");
-			
-			for(auto const& [_, value] : headersIt->items())
+			InputFile optsFile(cli.files[0]);
+			if (!optsFile.isOpen())
 			{
-				if (value.type() != json::value_t::string)
-					continue;
-
-				opts_.headerFiles.push_back(value.get<std::string>());
+				fmt::print("Error: could not open \"{}\" options file for reading.", cli.files[0]);
+				return 0;
 			}
+			readAppOptions(opts, optsFile.contents());
 		}
+		applyCliOptions(opts, cli);
+
+		return runBenchmark(opts, cli) ? 0 : 1;
 	}
+	
+	if (!cli.batch.empty())
+		return runBatch(cli) ? 0 : 1;
 
-	#undef READ_OPTION
+	if (!cli.compileCostReport.empty() && cli.files.size() >= 2)
+	{
+		InputFile optsFile(cli.files[0]);
+		if (!optsFile.isOpen())
+		{
+			fmt::print("Error: could not open \"{}\" options file for reading.", cli.files[0]);
+			return 0;
+		}
+
+		AppOptions opts;
+		readAppOptions(opts, optsFile.contents());
+		applyCliOptions(opts, cli);
+
+		runCompileCostReport(opts, cli);
+		return 0;
+	}
+
+	if (cli.files.size() < 3)
+	{
+		std::cout << "Usage: " << args[0] << " [options file name] [input file name] [output file name] [--stream] [--incremental] [--watch] [--jobs N] [--languages ID,ID...] [--stats] [--stats-json FILE]\n";
+		std::cout << "       " << args[0] << " --batch [manifest file name] [--stream] [--incremental] [--jobs N] [--languages ID,ID...] [--stats] [--stats-json FILE]\n";
+		std::cout << "       " << args[0] << " --report-compile-cost [report file name] [options file name] [input file name] [--languages ID,ID...]\n";
+		std::cout << "       " << args[0] << " --bench [options file name] [--bench-messages N] [--bench-languages N] [--bench-length MIN:MAX] [--bench-runs N] [--bench-baseline FILE] [--bench-tolerance PERCENT] [--jobs N]\n";
+		return 0;
+	}
+
+	if (cli.watch)
+	{
+		runWatch(cli);
+		return 0;
+	}
+
+	GenerationStats stats;
+	GenerationContext ctx{ nullptr, (cli.stats || !cli.statsJson.empty()) ? &stats : nullptr, cli.jobs };
+	Stopwatch stopwatch;
+
+	InputFile optsFile(cli.files[0]);
+	if (!optsFile.isOpen())
+	{
+		fmt::print("Error: could not open \"{}\" options file for reading.", cli.files[0]);
+		return 0;
+	}
+
+	AppOptions opts;
+	readAppOptions(opts, optsFile.contents());
+	applyCliOptions(opts, cli);
+	stats.readOptions	= stopwatch.lap();
+	stats.bytesRead		+= optsFile.contents().size();
+
+	if (!generateProject(opts, cli, cli.files[1], cli.files[2], ctx, stats))
+		return 0;
+
+	if (cli.stats)
+		printStats(stats);
+
+	if (!cli.statsJson.empty() && !writeOutputFile(OutputFile{ std::string(cli.statsJson), statsToJson(stats).dump(1, '\t') + '\n' }))
+		fmt::print("Error: could not open \"{}\" file for writing.", cli.statsJson);
+	return 0;
 }
 
 ////////////////////////////////////////////////
-auto readFileSequentially(std::istream& inputStream_) -> std::string
+auto generateProject(AppOptions const& opts_, CliOptions const& cli_, std::string_view inputPath_, std::string_view outputPath_, GenerationContext ctx_, GenerationStats& stats_) -> bool
 {
-	std::string out;
-	out.reserve(1 * 1024 * 1024);
+	Stopwatch stopwatch;
 
+	// Mapped input is actually read during parsing, watched input is copied first:
+	InputFile inFile(inputPath_, cli_.watch ? InputFile::Mode::Read : InputFile::Mode::Map);
+	if (!inFile.isOpen())
+	{
+		fmt::print("Error: could not open \"{}\" input file for reading.", inputPath_);
+		return false;
+	}
+	stats_.readInput	= stopwatch.lap();
+	stats_.bytesRead	+= inFile.contents().size();
+
+	std::vector<std::string> unusedMessages;
+	if (opts_.usedMessages)
+		ctx_.unusedMessages = &unusedMessages;
+
+	std::optional<MessageValidator> validator;
+	if (opts_.validate)
+		ctx_.validator = &validator.emplace(opts_);
+
+	// A failed "--watch" run keeps the last good output and a project that fails "validate" leaves
+	// no partial header, so the header is generated in memory and written once the whole project was generated:
+	if (opts_.shardBy != ShardMode::None || opts_.emitMode != EmitMode::Classes || cli_.incremental || cli_.watch || opts_.validate)
+	{
+		// Watch mode keeps its own cache resident between runs:
+		std::unique_ptr<MessageCache> cache;
+		if (cli_.incremental && !ctx_.cache)
+		{
+			cache = std::make_unique<MessageCache>(opts_, std::string(outputPath_) + ".cache");
+			ctx_.cache = cache.get();
+		}
 
-	char buffer[4 * 1024];
-	while(inputStream_.read(buffer, sizeof(buffer)))
-		out.append(buffer, buffer + inputStream_.gcount());
+		auto files = generateOutputFiles(opts_, cli_, inFile.contents(), outputPath_, ctx_);
+		stopwatch.lap();
 
-	out.append(buffer, buffer + inputStream_.gcount());
+		for (auto const& file : files)
+			stats_.bytesGenerated += file.contents.size();
 
-	return out;
+		if (cli_.incremental)
+		{
+			// Errors of single files are printed by writeOutputFilesIncremental:
+			if (!writeOutputFilesIncremental(files, std::string(outputPath_) + ".manifest", ctx_.stats))
+				return false;
+			if (!ctx_.cache->save())
+			{
+				fmt::print("Error: could not open \"{}.cache\" file for writing.", outputPath_);
+				return false;
+			}
+		}
+		else
+		{
+			for (auto const& file : files)
+			{
+				if (!writeOutputFile(file))
+				{
+					fmt::print("Error: could not open \"{}\" file for writing.", file.path);
+					return false;
+				}
+				stats_.bytesWritten += file.contents.size();
+				++stats_.filesWritten;
+			}
+		}
+		stats_.write = stopwatch.lap();
+	}
+	else
+	{
+		FileSink outFile(outputPath_);
+		if (!outFile.isOpen())
+		{
+			fmt::print("Error: could not open \"{}\" file for writing.", outputPath_);
+			return false;
+		}
+
+		// Messages are written as soon as they are formatted, so emission includes most of the writing:
+		if (cli_.streaming)
+			streamChatJson(opts_, inFile.contents(), outFile, ctx_);
+		else
+			writeChatJson(opts_, inFile.contents(), outFile, ctx_);
+		stopwatch.lap();
+
+		outFile.close();
+		stats_.write = stopwatch.lap();
+		stats_.bytesGenerated = stats_.bytesWritten = outFile.bytesWritten();
+		stats_.filesWritten = 1;
+	}
+
+	if (opts_.idRegistry && !opts_.idRegistry->save())
+	{
+		fmt::print("Error: could not open \"{}\" file for writing.", opts_.idRegistryFile);
+		return false;
+	}
+
+	stats_.unusedMessages = unusedMessages.size();
+	if (!opts_.unusedMessagesReport.empty())
+	{
+		OutputFile report{ opts_.unusedMessagesReport, std::string{} };
+		for (auto const& name : unusedMessages)
+		{
+			report.contents += name;
+			report.contents += '\n';
+		}
+
+		if (!writeOutputFile(report))
+		{
+			fmt::print("Error: could not open \"{}\" file for writing.", report.path);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////
+auto runBatch(CliOptions const& cli_) -> bool
+{
+	namespace fs = std::filesystem;
+
+	std::string manifestPath(cli_.batch);
+	InputFile manifestFile(manifestPath);
+	if (!manifestFile.isOpen())
+	{
+		fmt::print("Error: could not open \"{}\" batch manifest for reading.", manifestPath);
+		return false;
+	}
+
+	auto contents = manifestFile.contents();
+	json manifest = json::parse(contents.begin(), contents.end());
+	if (!manifest.is_array())
+		throw std::runtime_error("Could not parse batch manifest - root value is not an array.");
+
+	fs::path baseDir = fs::path(manifestPath).parent_path();
+	auto resolve = [&](json const& path_)
+	{
+		if (!path_.is_string())
+			throw std::runtime_error("Could not parse batch manifest - file name is not a string.");
+		return (baseDir / path_.get<std::string>()).string();
+	};
+
+	struct Project
+	{
+		AppOptions const*	opts;
+		std::string			input;
+		std::string			output;
+		GenerationStats		stats;
+		std::string			error;
+	};
+
+	// Options are shared by all projects whose options files have the same contents:
+	std::deque<AppOptions>						options;
+	std::unordered_map<std::string, size_t>		optionsByContents;
+	std::vector<Project>				projects;
+	projects.reserve(manifest.size());
+
+	for (auto const& entry : manifest)
+	{
+		if (!entry.is_array() || entry.size() != 3)
+			throw std::runtime_error("Could not parse batch manifest - entry is not an [options, input, output] array.");
+
+		auto optsPath = resolve(entry[0]);
+		InputFile optsFile(optsPath);
+		if (!optsFile.isOpen())
+		{
+			fmt::print("Error: could not open \"{}\" options file for reading.", optsPath);
+			return false;
+		}
+
+		auto [it, inserted] = optionsByContents.try_emplace(std::string(optsFile.contents()), options.size());
+		if (inserted)
+		{
+			readAppOptions(options.emplace_back(), optsFile.contents());
+			applyCliOptions(options.back(), cli_);
+		}
+
+		projects.push_back(Project{ &options[it->second], resolve(entry[1]), resolve(entry[2]), {}, {} });
+	}
+
+	bool collectStats	= cli_.stats || !cli_.statsJson.empty();
+	size_t threadCount	= std::max<size_t>(std::min(cli_.jobs, projects.size()), 1);
+	std::atomic<size_t> nextProject{ 0 };
+
+	auto worker = [&]
+	{
+		for (size_t i; (i = nextProject++) < projects.size();)
+		{
+			auto& project = projects[i];
+			GenerationContext ctx{ nullptr, collectStats ? &project.stats : nullptr, threadCount > 1 ? 1 : cli_.jobs };
+			try
+			{
+				// generateProject prints what failed:
+				if (!generateProject(*project.opts, cli_, project.input, project.output, ctx, project.stats))
+					project.error = "could not generate the project.";
+			}
+			catch (std::exception const& e)
+			{
+				project.error = e.what();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (size_t i = 1; i < threadCount; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+
+	bool success = true;
+	json statsJson = json::array();
+	for (auto const& project : projects)
+	{
+		if (!project.error.empty())
+		{
+			fmt::print("Error: \"{}\": {}\n", project.input, project.error);
+			success = false;
+		}
+
+		if (cli_.stats)
+		{
+			fmt::print("{}:\n", project.output);
+			printStats(project.stats);
+		}
+
+		if (!cli_.statsJson.empty())
+		{
+			json projectStats = statsToJson(project.stats);
+			projectStats["output"] = project.output;
+			statsJson.push_back(std::move(projectStats));
+		}
+	}
+
+	if (!cli_.statsJson.empty() && !writeOutputFile(OutputFile{ std::string(cli_.statsJson), statsJson.dump(1, '\t') + '\n' }))
+	{
+		fmt::print("Error: could not open \"{}\" file for writing.", cli_.statsJson);
+		success = false;
+	}
+	return success;
+}
+
+////////////////////////////////////////////////
+auto runWatch(CliOptions const& cli_) -> void
+{
+	std::string optsPath(cli_.files[0]);
+	std::string inputPath(cli_.files[1]);
+	std::string outputPath(cli_.files[2]);
+
+	FileWatcher watcher({ optsPath, inputPath });
+	fmt::print("Watching \"{}\" and \"{}\" for changes, press Ctrl+C to stop.\n", inputPath, optsPath);
+
+	AppOptions opts;
+	std::unique_ptr<MessageCache> cache;
+	bool reloadOptions = true;
+
+	for (;;)
+	{
+		Stopwatch stopwatch;
+		GenerationStats stats;
+		try
+		{
+			// Cached code depends on the options, so it is dropped with them:
+			if (reloadOptions)
+			{
+				cache.reset();
+				opts = AppOptions{};
+
+				InputFile optsFile(optsPath, InputFile::Mode::Read);
+				if (!optsFile.isOpen())
+					throw std::runtime_error(fmt::format("could not open \"{}\" options file for reading.", optsPath));
+
+				readAppOptions(opts, optsFile.contents());
+				applyCliOptions(opts, cli_);
+				cache = std::make_unique<MessageCache>(opts, outputPath + ".cache");
+			}
+
+			GenerationContext ctx{ cache.get(), &stats, cli_.jobs };
+			if (generateProject(opts, cli_, inputPath, outputPath, ctx, stats))
+			{
+				// Saving the incremental cache keeps it in memory as well:
+				if (!cli_.incremental)
+					cache->rotate();
+
+				fmt::print("Regenerated \"{}\" in {:.1f} ms ({} messages, {} reused).\n",
+					outputPath, stopwatch.lap() * 1000.0, stats.messages, stats.cachedMessages);
+				if (cli_.stats)
+					printStats(stats);
+			}
+			else
+			{
+				fmt::print("\n");
+				cache->rollback();
+			}
+		}
+		catch (std::exception const& e)
+		{
+			if (cache)
+				cache->rollback();
+			fmt::print("Error: {}\n", e.what());
+		}
+		std::fflush(stdout);
+
+		auto changed = watcher.wait();
+		reloadOptions = !cache || std::find(changed.begin(), changed.end(), 0) != changed.end();
+	}
+}
+
+////////////////////////////////////////////////
+auto generateOutputFiles(AppOptions const& opts_, CliOptions const& cli_, std::string_view fileContents_, std::string_view outputPath_, GenerationContext const& ctx_) -> std::vector<OutputFile>
+{
+	std::string outputPath(outputPath_);
+
+	if (opts_.emitMode != EmitMode::Classes)
+	{
+		if (opts_.shardBy != ShardMode::None)
+			throw std::runtime_error("Could not generate chat messages - \"shardBy\" is supported only with \"emitMode\": \"classes\".");
+
+		Stopwatch stopwatch;
+		auto project = collectChatProject(opts_, fileContents_, cli_.streaming, ctx_);
+		if (ctx_.stats)
+		{
+			ctx_.stats->parse		+= stopwatch.lap();
+			ctx_.stats->messages	+= project.messages.size();
+			ctx_.stats->languages	= project.langs.size();
+		}
+
+		if (opts_.emitMode == EmitMode::Extern)
+		{
+			auto files = emitExtern(opts_, project, outputPath);
+			if (ctx_.stats)
+				ctx_.stats->emit += stopwatch.lap();
+			return files;
+		}
+
+		OutputFile file;
+		file.path = std::move(outputPath);
+		if (opts_.emitMode == EmitMode::Catalog)
+		{
+			file.contents			= emitCatalog(opts_, project);
+			file.replaceAtomically	= true;
+		}
+		else
+			file.contents = emitStringTable(opts_, project);
+
+		if (ctx_.stats)
+			ctx_.stats->emit += stopwatch.lap();
+		return { std::move(file) };
+	}
+
+	if (opts_.shardBy != ShardMode::None)
+		return shardChatJson(opts_, fileContents_, cli_.streaming, outputPath, ctx_);
+
+	if (cli_.streaming)
+	{
+		std::string output;
+		StringSink sink(output, ctx_.stats ? &ctx_.stats->outputReallocations : nullptr);
+		streamChatJson(opts_, fileContents_, sink, ctx_);
+		return { OutputFile{ std::move(outputPath), std::move(output) } };
+	}
+
+	return { OutputFile{ std::move(outputPath), parseChatJson(opts_, fileContents_, ctx_) } };
+}
+
+std::string parseChatJson(AppOptions const& opts_, std::string_view fileContents_, GenerationContext const& ctx_)
+{
+	std::string output;
+	output.reserve(1 * 1024 * 1024);
+
+	StringSink sink(output, ctx_.stats ? &ctx_.stats->outputReallocations : nullptr);
+	writeChatJson(opts_, fileContents_, sink, ctx_);
+	return output;
+}
+
+////////////////////////////////////////////////
+auto writeChatJson(AppOptions const& opts_, std::string_view fileContents_, OutputSink& output_, GenerationContext const& ctx_) -> void
+{
+	Stopwatch stopwatch;
+
+	json j = json::parse(fileContents_.begin(), fileContents_.end());
+
+	std::vector<json const*> messages;
+	LanguageTable langs = visitChatDocument(opts_, j,
+		[&](LanguageTable const&, json const& message_)
+		{
+			messages.push_back(&message_);
+		}, ctx_);
+
+	if (ctx_.stats)
+	{
+		ctx_.stats->parse		+= stopwatch.lap();
+		ctx_.stats->languages	= langs.size();
+	}
+
+	std::string output;
+	appendPrologue(opts_, output);
+	output_.write(output);
+
+	formatChatMessages(opts_, langs, messages, ctx_, output_);
+
+	output.clear();
+	appendLanguageIndex(opts_, langs, output);
+	if (opts_.nameLookup || opts_.runtimeApi)
+	{
+		std::vector<std::string> names;
+		names.reserve(messages.size());
+		for (auto message : messages)
+			names.emplace_back(chatMessageName(*message));
+		assignMessageIds(opts_, names);
+		if (opts_.nameLookup)
+			appendNameLookup(opts_, names, output);
+		if (opts_.runtimeApi)
+			appendRuntimeApi(opts_, langs, names, output);
+	}
+	appendEpilogue(opts_, output);
+	output_.write(output);
+
+	if (ctx_.stats)
+		ctx_.stats->emit += stopwatch.lap();
+}
+
+////////////////////////////////////////////////
+LanguageTable::LanguageTable(AppOptions const& opts_, json const& languages_)
+{
+	languages.reserve(languages_.size());
+	for (auto const& lang : languages_.items())
+	{
+		auto const& val = lang.value();
+		if (val.type() != json::value_t::object)
+			throw std::runtime_error("Could not parse JSON file - language content is not an object.");
+
+		Language language;
+		language.id		= val.at("id").get<std::string>();
+		language.name	= val.at("name").get<std::string>();
+		if (!opts_.languageEnum.empty())
+		{
+			language.enumerator	= opts_.languageEnum + "::" + language.name;
+			language.index		= "static_cast<int>(" + language.enumerator + ")";
+		}
+
+		languages.push_back(std::move(language));
+	}
+
+	// Later definitions of the same id win:
+	std::stable_sort(languages.begin(), languages.end(),
+		[](Language const& lhs_, Language const& rhs_) { return lhs_.id < rhs_.id; });
+
+	auto last = std::unique(languages.rbegin(), languages.rend(),
+		[](Language const& lhs_, Language const& rhs_) { return lhs_.id == rhs_.id; });
+	languages.erase(languages.begin(), last.base());
+
+	if (opts_.languages.empty())
+	{
+		// Without the enum, the registry fixes indexes and arrays get a slot for every language it ever had:
+		if (opts_.idRegistry && opts_.languageEnum.empty())
+		{
+			for (auto& language : languages)
+				language.index = std::to_string(opts_.idRegistry->languageId(language.id));
+			slotCount = opts_.idRegistry->languageCount();
+		}
+		return;
+	}
+
+	// Keep only the selected languages and number them densely:
+	for (auto const& id : opts_.languages)
+	{
+		if (!find(id))
+			throw std::runtime_error(fmt::format("Could not parse JSON file - language \"{}\" selected with \"languages\" is not defined.", id));
+	}
+
+	languages.erase(std::remove_if(languages.begin(), languages.end(),
+		[&](Language const& lang_) { return std::find(opts_.languages.begin(), opts_.languages.end(), lang_.id) == opts_.languages.end(); }),
+		languages.end());
+
+	// Texts are placed by language, a message without a text leaves its slot empty:
+	for (auto& language : languages)
+		language.index = std::to_string(denseId(language));
+	slotCount = languages.size();
+}
+
+////////////////////////////////////////////////
+auto LanguageTable::find(std::string_view id_) const -> Language const*
+{
+	auto it = std::lower_bound(languages.begin(), languages.end(), id_,
+		[](Language const& lang_, std::string_view id_) { return lang_.id < id_; });
+
+	if (it == languages.end() || it->id != id_)
+		return nullptr;
+	return &*it;
+}
+
+////////////////////////////////////////////////
+auto appendPrologue(AppOptions const& opts_, std::string& output_) -> void
+{
+	appendIncludes(opts_, output_);
+	appendNamespaceBegin(opts_, output_);
+
+	output_ += "namespace internal {\nstruct ChatMessageBase {};\n}\n\n";
+
+	if (opts_.formatMetadata)
+	{
+		output_ +=
+			"namespace internal {\n"
+			"// Literal text followed by an argument (arg is -1 for the trailing literal):\n"
+			"struct FormatSegment\n"
+			"{\n"
+			"\tstd::string_view\tliteral;\n"
+			"\tint\t\t\t\t\targ;\n"
+			"\tstd::string_view\tspec;\n"
+			"};\n\n"
+			"struct FormatInfo\n"
+			"{\n"
+			"\tstd::size_t\t\t\t\targCount;\n"
+			"\tFormatSegment const*\tsegments;\n"
+			"\tstd::size_t\t\t\t\tsegmentCount;\n"
+			"};\n"
+			"}\n\n";
+	}
+
+	if (opts_.typedFormat)
+	{
+		output_ +=
+			"namespace internal {\n"
+			"// SAMP clients show at most 144 characters of a chat message:\n"
+			"inline constexpr std::size_t MaxChatLength = 144;\n\n"
+			"// Formatted message, NUL-terminated:\n"
+			"struct ChatBuffer\n"
+			"{\n"
+			"\tchar\t\tdata[MaxChatLength + 1];\n"
+			"\tstd::size_t\tsize = 0;\n\n"
+			"\tstd::string_view view() const\t{ return std::string_view(data, size); }\n"
+			"};\n\n"
+			"// Appends to a ChatBuffer and silently cuts at MaxChatLength:\n"
+			"class ChatWriter\n"
+			"{\n"
+			"public:\n"
+			"\texplicit ChatWriter(ChatBuffer& buffer_)\n"
+			"\t\t: buffer(buffer_)\n"
+			"\t{\n"
+			"\t\tbuffer.size = 0;\n"
+			"\t}\n\n"
+			"\ttemplate <std::size_t N>\n"
+			"\tvoid literal(char const (&text_)[N])\t{ append(text_, N - 1); }\n\n"
+			"\tvoid arg(std::string_view value_)\t\t{ append(value_.data(), value_.size()); }\n\n"
+			"\ttemplate <class T>\n"
+			"\tvoid arg(T const& value_)\t\t\t\t{ arg(FMT_COMPILE(\"{}\"), value_); }\n\n"
+			"\ttemplate <class Format, class T>\n"
+			"\tvoid arg(Format const& format_, T const& value_)\n"
+			"\t{\n"
+			"\t\tstd::size_t space = MaxChatLength - buffer.size;\n"
+			"\t\tauto result = fmt::format_to_n(buffer.data + buffer.size, space, format_, value_);\n"
+			"\t\tbuffer.size += (std::min)(static_cast<std::size_t>(result.size), space);\n"
+			"\t}\n\n"
+			"\tstd::string_view finish()\n"
+			"\t{\n"
+			"\t\tbuffer.data[buffer.size] = '\\0';\n"
+			"\t\treturn buffer.view();\n"
+			"\t}\n\n"
+			"private:\n"
+			"\tvoid append(char const* data_, std::size_t size_)\n"
+			"\t{\n"
+			"\t\tsize_ = (std::min)(size_, MaxChatLength - buffer.size);\n"
+			"\t\tstd::memcpy(buffer.data + buffer.size, data_, size_);\n"
+			"\t\tbuffer.size += size_;\n"
+			"\t}\n\n"
+			"\tChatBuffer& buffer;\n"
+			"};\n"
+			"}\n\n";
+	}
+
+	if (opts_.textInfo)
+	{
+		output_ +=
+			"namespace internal {\n"
+			"// Length of the text in bytes and whether it has to be formatted:\n"
+			"struct TextInfo\n"
+			"{\n"
+			"\tstd::size_t\tlength;\n"
+			"\tbool\t\thasPlaceholders;\n"
+			"};\n"
+			"}\n\n";
+	}
+}
+
+////////////////////////////////////////////////
+auto appendIncludes(AppOptions const& opts_, std::string& output_) -> void
+{
+	// Append pragma once
+	if (opts_.usePragmaOnce)
+		output_ += "#pragma once\n\n";
+
+	// Append pch
+	if (!opts_.pch.empty())
+	{
+		output_ += "#include ";
+		output_ += opts_.pch;
+		output_ += '\n';
+	}
+
+	// Append header files
+	for (auto const& headerFile : opts_.headerFiles)
+	{
+		output_ += "#include ";
+		output_ += headerFile;
+		output_ += '\n';
+	}
+
+	if ((opts_.nameLookup || opts_.formatMetadata || opts_.runtimeApi || opts_.textInfo || opts_.typedFormat) && opts_.emitMode == EmitMode::Classes)
+		output_ += "#include <array>\n#include <cstddef>\n#include <cstdint>\n#include <string_view>\n";
+	if (opts_.runtimeApi && opts_.emitMode == EmitMode::Classes)
+		output_ += "#include <optional>\n#include <type_traits>\n";
+	if (opts_.typedFormat && opts_.emitMode == EmitMode::Classes)
+		output_ += "#include <algorithm>\n#include <cstring>\n#include <fmt/compile.h>\n";
+
+	output_ += "\n\n";
+}
+
+////////////////////////////////////////////////
+auto appendNamespaceBegin(AppOptions const& opts_, std::string& output_) -> void
+{
+	// Append namespace
+	if (!opts_.ns.empty())
+	{
+		output_ += "namespace ";
+		output_ += opts_.ns;
+		output_ += "\n{\n\n";
+	}
+}
+
+////////////////////////////////////////////////
+auto appendEpilogue(AppOptions const& opts_, std::string& output_) -> void
+{
+	// Append namespace end
+	if (!opts_.ns.empty())
+		output_ += "\n}\n";
+}
+
+////////////////////////////////////////////////
+auto appendChatMessage(AppOptions const& opts_, LanguageTable const& langs_, json const& value_, std::string& output_) -> void
+{
+	if (value_.type() != json::value_t::object)
+		return;
+
+	auto nameIt		= value_.find("uniqueName");
+	auto contentIt	= value_.find("content");
+	if (nameIt == value_.end() || contentIt == value_.end())
+		return;
+
+	if (!nameIt->is_string())
+		throw std::runtime_error("Could not parse JSON file - chat message \"uniqueName\" is not a string.");
+	auto const& uniqueName	= nameIt->get_ref<std::string const&>();
+	auto const& content		= *contentIt;
+	if (!content.is_object())
+		throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" has \"content\" that is not an object.", uniqueName));
+
+	// Code is written straight into the output, so the loop below does no heap
+	// allocation once output_ has grown (it is reused between messages).
+	// Texts are referenced in the parsed document, nothing is copied before it is appended.
+	// Load first comment-version of a message as a comment:
+	std::string_view comment;
+	for (auto const& [langId, msgContent] : content.items())
+	{
+		comment = messageText(msgContent, "comment", uniqueName, langId);
+		if (!comment.empty())
+			break;
+	}
+
+	output_ += "// \"";
+	appendCommentText(comment, output_);
+	output_ +=
+		"\"\n"
+		"class \n\t: public internal::ChatMessageBase\n"
+		"{\n"
+		"\tstatic constexpr auto generateContent = []\n\t{\n"
+		"\t\tstd::array<std::string_view, ";
+	size_t arraySize = langs_.slots() ? langs_.slots() : content.size();
+	appendNumber(arraySize, output_);
+	output_ += "> result;\n";
+
+	// Used with "formatMetadata", reused by every message formatted on this thread:
+	thread_local std::string formatSegments;
+	thread_local std::string formatContent;
+	size_t segmentCount = 0;
+	size_t argCount = 0;
+	std::string_view firstLangId;
+	if (opts_.formatMetadata)
+	{
+		formatSegments.clear();
+		formatContent.clear();
+	}
+
+	// Used with "textInfo":
+	thread_local std::string infoContent;
+	if (opts_.textInfo)
+		infoContent.clear();
+
+	// Used with "typedFormat", types of declared or inferred arguments:
+	thread_local std::string typedContent;
+	thread_local std::vector<std::string> argTypes;
+	size_t declaredArgCount = 0;
+	if (opts_.typedFormat)
+	{
+		typedContent.clear();
+		argTypes.clear();
+
+		auto argsIt = value_.find("args");
+		if (argsIt != value_.end())
+		{
+			if (!argsIt->is_array())
+				throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" has \"args\" that is not an array.", uniqueName));
+
+			for (auto const& arg : *argsIt)
+			{
+				if (!arg.is_string() || arg.get_ref<std::string const&>().empty())
+					throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" has an \"args\" entry that is not a type name.", uniqueName));
+				argTypes.push_back(formatArgType(arg.get_ref<std::string const&>()));
+			}
+			declaredArgCount = argTypes.size();
+		}
+	}
+
+	size_t langIndex = 0;
+	for (auto const& [langId, msgContent] : content.items())
+	{
+		auto const& processed = messageText(msgContent, "processed", uniqueName, langId);
+		auto codepage = languageCodepage(opts_, langId);
+
+		// Each language is appended here:
+		output_ += "\t\tresult[";
+		size_t indexBegin = output_.size();
+		std::string_view enumerator;
+		if (opts_.languageEnum.empty() && langs_.slots() == 0)
+			appendNumber(langIndex, output_);
+		else
+		{
+			auto lang = langs_.find(langId);
+			if (!lang)
+				throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" uses unknown language \"{}\".", uniqueName, langId));
+			output_ += lang->index;
+			enumerator = lang->enumerator;
+		}
+		std::string_view index(output_.data() + indexBegin, output_.size() - indexBegin);
+
+		size_t textArgCount = 0;
+		if (opts_.formatMetadata || opts_.typedFormat)
+		{
+			auto format = parseFormatString(processed, uniqueName, langId);
+			textArgCount = format.argCount;
+
+			if (langIndex == 0)
+			{
+				argCount	= format.argCount;
+				firstLangId	= langId;
+			}
+			else if (format.argCount != argCount)
+				throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" has {} format arguments in \"{}\", but {} in \"{}\".",
+					uniqueName, argCount, firstLangId, format.argCount, langId));
+
+			if (opts_.typedFormat)
+			{
+				fmt::format_to(std::back_inserter(typedContent), "\t\tcase {}:\n", enumerator.empty() ? index : enumerator);
+				for (auto const& segment : format.segments)
+				{
+					if (!segment.literal.empty())
+					{
+						typedContent += "\t\t\tout.literal(\"";
+						appendLiteralText(opts_, segment.literal, uniqueName, typedContent, codepage);
+						typedContent += "\");\n";
+					}
+					if (segment.arg < 0)
+						continue;
+
+					auto arg = static_cast<size_t>(segment.arg);
+					if (argTypes.size() <= arg)
+						argTypes.resize(arg + 1);
+					if (argTypes[arg].empty())
+						argTypes[arg] = inferArgType(segment.spec);
+
+					if (segment.spec.empty())
+						fmt::format_to(std::back_inserter(typedContent), "\t\t\tout.arg(a{});\n", arg);
+					else
+					{
+						typedContent += "\t\t\tout.arg(FMT_COMPILE(\"{:";
+						appendLiteralText(opts_, segment.spec, uniqueName, typedContent);
+						fmt::format_to(std::back_inserter(typedContent), "}}\"), a{});\n", arg);
+					}
+				}
+				typedContent += "\t\t\tbreak;\n";
+			}
+
+			if (opts_.formatMetadata)
+			{
+				for (auto const& segment : format.segments)
+				{
+					formatSegments += "\t\t{ \"";
+					appendLiteralText(opts_, segment.literal, uniqueName, formatSegments, codepage);
+					formatSegments += "\", ";
+					fmt::format_to(std::back_inserter(formatSegments), "{}", segment.arg);
+					formatSegments += ", \"";
+					appendLiteralText(opts_, segment.spec, uniqueName, formatSegments, codepage);
+					formatSegments += "\" },\n";
+				}
+
+				fmt::format_to(std::back_inserter(formatContent), "\t\tresult[{}] = internal::FormatInfo{{ {}, formatSegments + {}, {} }};\n",
+					index, format.argCount, segmentCount, format.segments.size());
+				segmentCount += format.segments.size();
+			}
+		}
+		else if (opts_.textInfo)
+			textArgCount = parseFormatString(processed, uniqueName, langId).argCount;
+
+		if (opts_.textInfo)
+		{
+			fmt::format_to(std::back_inserter(infoContent), "\t\tresult[{}] = internal::TextInfo{{ {}, {} }};\n",
+				index, literalBytes(opts_, processed, codepage, uniqueName, langId).size(), textArgCount > 0 ? "true" : "false");
+		}
+
+		output_ += "] = ";
+
+		if (opts_.useCompileMacro)
+			output_ += "FMT_COMPILE(";
+
+		output_ += '"';
+		appendLiteralText(opts_, processed, uniqueName, output_, codepage);
+		output_ += '"';
+
+		if (opts_.useCompileMacro)
+			output_ += ')';
+
+		output_ += ";\n";
+		++langIndex;
+	}
+	// End of languages
+
+	output_ +=
+		"\t\treturn result;\n"
+		"\t};\n";
+
+	if (opts_.formatMetadata)
+	{
+		output_ += "\tstatic constexpr internal::FormatSegment formatSegments[";
+		appendNumber(std::max<size_t>(segmentCount, 1), output_);
+		output_ += "] = {\n";
+		output_ += formatSegments;
+		output_ += "\t};\n";
+	}
+
+	output_ +=
+		"public:\n"
+		"\tstatic constexpr auto text = generateContent();\n";
+
+	if (opts_.formatMetadata)
+	{
+		output_ +=
+			"\tstatic constexpr auto format = []\n\t{\n"
+			"\t\tstd::array<internal::FormatInfo, ";
+		appendNumber(arraySize, output_);
+		output_ += "> result{};\n";
+		output_ += formatContent;
+		output_ +=
+			"\t\treturn result;\n"
+			"\t}();\n";
+	}
+
+	if (opts_.textInfo)
+	{
+		output_ +=
+			"\tstatic constexpr auto info = []\n\t{\n"
+			"\t\tstd::array<internal::TextInfo, ";
+		appendNumber(arraySize, output_);
+		output_ += "> result{};\n";
+		output_ += infoContent;
+		output_ +=
+			"\t\treturn result;\n"
+			"\t}();\n";
+	}
+
+	if (opts_.typedFormat)
+	{
+		if (value_.contains("args") && declaredArgCount != argCount)
+			throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" declares {} \"args\", but its texts use {} format arguments.",
+				uniqueName, declaredArgCount, argCount));
+		argTypes.resize(argCount);
+
+		output_ += "\t// Formats the text in the language into buffer_ without allocating, cut at internal::MaxChatLength:\n";
+		bool isTemplate = false;
+		for (size_t arg = 0; arg < argCount; ++arg)
+		{
+			if (!argTypes[arg].empty())
+				continue;
+			output_ += isTemplate ? ", " : "\ttemplate <";
+			fmt::format_to(std::back_inserter(output_), "class A{}", arg);
+			isTemplate = true;
+		}
+		if (isTemplate)
+			output_ += ">\n";
+
+		output_ += "\tstatic std::string_view formatTo(";
+		output_ += opts_.languageEnum.empty() ? std::string_view("std::size_t") : std::string_view(opts_.languageEnum);
+		output_ += " language_, internal::ChatBuffer& buffer_";
+		for (size_t arg = 0; arg < argCount; ++arg)
+		{
+			if (argTypes[arg].empty())
+				fmt::format_to(std::back_inserter(output_), ", A{0} const& a{0}", arg);
+			else
+				fmt::format_to(std::back_inserter(output_), ", {} a{}", argTypes[arg], arg);
+		}
+		output_ +=
+			")\n"
+			"\t{\n"
+			"\t\tinternal::ChatWriter out(buffer_);\n";
+		output_ +=
+			"\t\tswitch (language_)\n"
+			"\t\t{\n";
+		output_ += typedContent;
+		output_ +=
+			"\t\tdefault:\n"
+			"\t\t\tbreak;\n"
+			"\t\t}\n"
+			"\t\treturn out.finish();\n"
+			"\t}\n";
+	}
+
+	output_ += "} inline constexpr ";
+	output_ += uniqueName;
+	output_ += ";\n\n";
+}
+
+////////////////////////////////////////////////
+// Decimal digits without a temporary string.
+auto appendNumber(size_t value_, std::string& output_) -> void
+{
+	fmt::format_int digits(value_);
+	output_.append(digits.data(), digits.size());
+}
+
+////////////////////////////////////////////////
+auto parseFormatString(std::string_view text_, std::string_view uniqueName_, std::string_view langId_) -> FormatString
+{
+	auto error = [&](char const* what_)
+	{
+		return std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" in \"{}\" has an invalid format string: {}.", uniqueName_, langId_, what_));
+	};
+	auto isHexColor = [](std::string_view id_)
+	{
+		return id_.size() == 6 && std::all_of(id_.begin(), id_.end(), [](char ch_) { return std::isxdigit(static_cast<unsigned char>(ch_)) != 0; });
+	};
+
+	// A 144 character chat line can't hold more arguments, larger ids would only size parameter lists:
+	constexpr int MaxArgId = 32;
+
+	FormatString format;
+	std::string literal;
+	int nextArg = 0;
+	bool automatic = false, manual = false;
+
+	for (size_t i = 0; i < text_.size(); ++i)
+	{
+		char ch = text_[i];
+		if (ch == '}')
+		{
+			if (i + 1 < text_.size() && text_[i + 1] == '}')
+				++i;
+			else
+				throw error("unmatched '}'");
+			literal += '}';
+			continue;
+		}
+		if (ch != '{')
+		{
+			literal += ch;
+			continue;
+		}
+		if (i + 1 < text_.size() && text_[i + 1] == '{')
+		{
+			literal += '{';
+			++i;
+			continue;
+		}
+
+		size_t end = text_.find('}', i);
+		if (end == std::string_view::npos)
+			throw error("unmatched '{'");
+
+		auto field	= text_.substr(i + 1, end - i - 1);
+		auto colon	= field.find(':');
+		if (field.find('{') != std::string_view::npos)
+			throw error("nested replacement fields are not supported");
+		auto id		= field.substr(0, colon);
+
+		if (colon == std::string_view::npos && isHexColor(id))
+		{
+			literal.append(text_.data() + i, end - i + 1);
+			i = end;
+			continue;
+		}
+
+		int arg;
+		if (id.empty())
+		{
+			automatic = true;
+			arg = nextArg++;
+		}
+		else if (std::all_of(id.begin(), id.end(), [](char ch_) { return ch_ >= '0' && ch_ <= '9'; }))
+		{
+			manual = true;
+			if (id.size() > 9 || (arg = std::stoi(std::string(id))) > MaxArgId)
+				throw error("argument ids above 32 are not supported");
+		}
+		else
+			throw error("named arguments are not supported");
+
+		if (automatic && manual)
+			throw error("automatic and manual argument indexing can't be mixed");
+
+		format.segments.push_back(FormatString::Segment{ std::move(literal), arg, colon == std::string_view::npos ? std::string{} : std::string(field.substr(colon + 1)) });
+		format.argCount = std::max(format.argCount, static_cast<size_t>(arg) + 1);
+		literal.clear();
+		i = end;
+	}
+
+	format.segments.push_back(FormatString::Segment{ std::move(literal), -1, {} });
+	return format;
+}
+
+////////////////////////////////////////////////
+// Parameter type of a declared "args" entry, other names are used as C++ types (passed by const reference).
+auto formatArgType(std::string_view type_) -> std::string
+{
+	static std::pair<std::string_view, std::string_view> const types[] = {
+		{ "string",	"std::string_view" },
+		{ "int",	"int" },
+		{ "uint",	"unsigned" },
+		{ "int64",	"std::int64_t" },
+		{ "uint64",	"std::uint64_t" },
+		{ "float",	"float" },
+		{ "double",	"double" },
+		{ "char",	"char" },
+		{ "bool",	"bool" }
+	};
+
+	for (auto const& [name, cppType] : types)
+	{
+		if (name == type_)
+			return std::string(cppType);
+	}
+	return std::string(type_) + " const&";
+}
+
+////////////////////////////////////////////////
+// Parameter type implied by the presentation type of a format spec, empty when the spec doesn't tell.
+auto inferArgType(std::string_view spec_) -> std::string_view
+{
+	if (spec_.empty())
+		return {};
+
+	switch (spec_.back())
+	{
+	case 'd': case 'x': case 'X': case 'o': case 'b': case 'B':
+		return "int";
+	case 'c':
+		return "char";
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': case '%':
+		return "double";
+	case 's':
+		return "std::string_view";
+	default:
+		return {};
+	}
+}
+
+////////////////////////////////////////////////
+// uniqueName of a message that appendChatMessage emits, empty for skipped elements.
+auto chatMessageName(json const& value_) -> std::string_view
+{
+	if (value_.type() != json::value_t::object || value_.find("content") == value_.end())
+		return {};
+
+	auto it = value_.find("uniqueName");
+	if (it == value_.end() || !it->is_string())
+		return {};
+	return it->get_ref<std::string const&>();
+}
+
+////////////////////////////////////////////////
+// String field of a language entry in "content", referenced in place with a single lookup.
+auto messageText(json const& msgContent_, char const* field_, std::string_view uniqueName_, std::string_view langId_) -> std::string const&
+{
+	auto it = msgContent_.find(field_);
+	if (it == msgContent_.end() || !it->is_string())
+		throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" has no \"{}\" string in \"{}\".", uniqueName_, field_, langId_));
+	return it->get_ref<std::string const&>();
+}
+
+////////////////////////////////////////////////
+// Seeded FNV-1a with a final mix, so that the low bits used by modulo are well distributed.
+// The generated lookupHash() must compute exactly the same values.
+static constexpr auto lookupHash(std::string_view name_, uint64_t seed_) -> uint64_t
+{
+	uint64_t hash = 14695981039346656037ull ^ seed_;
+	for (char ch : name_)
+	{
+		hash ^= static_cast<unsigned char>(ch);
+		hash *= 1099511628211ull;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+////////////////////////////////////////////////
+// Lookup of messages by uniqueName, a minimal perfect hash built with "hash and displace":
+// lookupHash(name, 0) selects a bucket, the seed of the bucket selects a unique slot
+// with lookupHash(name, seed). Every lookup hashes twice and compares one name.
+auto appendNameLookup(AppOptions const& opts_, std::vector<std::string> const& names_, std::string& output_) -> void
+{
+	if (opts_.emitMode != EmitMode::Classes)
+		return;
+
+	// Skipped elements and repeated names (a compile error anyway) get no entry:
+	std::vector<size_t> keys;
+	{
+		std::unordered_set<std::string_view> seen;
+		for (size_t id = 0; id < names_.size(); ++id)
+		{
+			if (!names_[id].empty() && seen.insert(names_[id]).second)
+				keys.push_back(id);
+		}
+	}
+
+	size_t slotCount	= std::max<size_t>(keys.size(), 1);
+	size_t bucketCount	= std::max<size_t>(keys.size() / 2, 1);
+
+	std::vector< std::vector<size_t> > buckets(bucketCount);
+	for (auto id : keys)
+		buckets[lookupHash(names_[id], 0) % bucketCount].push_back(id);
+
+	// Largest buckets first, while most slots are still free:
+	std::vector<size_t> order(bucketCount);
+	for (size_t i = 0; i < bucketCount; ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(),
+		[&](size_t lhs_, size_t rhs_) { return buckets[lhs_].size() > buckets[rhs_].size(); });
+
+	constexpr size_t NoMessage = ~size_t(0);
+	std::vector<size_t>		slots(slotCount, NoMessage);
+	std::vector<uint32_t>	seeds(bucketCount, 0);
+	std::vector<size_t>		candidate;
+
+	for (auto bucket : order)
+	{
+		auto const& ids = buckets[bucket];
+		if (ids.empty())
+			break;
+
+		for (uint32_t seed = 1;; ++seed)
+		{
+			if (seed == 0)
+				throw std::runtime_error("Could not generate name lookup - no perfect hash seed found.");
+
+			candidate.clear();
+			for (auto id : ids)
+			{
+				size_t slot = lookupHash(names_[id], seed) % slotCount;
+				if (slots[slot] != NoMessage || std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+					break;
+				candidate.push_back(slot);
+			}
+
+			if (candidate.size() == ids.size())
+			{
+				for (size_t i = 0; i < ids.size(); ++i)
+					slots[candidate[i]] = ids[i];
+				seeds[bucket] = seed;
+				break;
+			}
+		}
+	}
+
+	output_ +=
+		"namespace internal {\n"
+		"struct MessageLookupEntry\n"
+		"{\n"
+		"\tstd::string_view\t\tname;\n"
+		"\tstd::size_t\t\t\t\tid;\n"
+		"\tstd::string_view const*\ttexts;\n"
+		"\tstd::size_t\t\t\t\ttextCount;\n"
+		"};\n\n"
+		"constexpr std::uint64_t lookupHash(std::string_view name_, std::uint64_t seed_)\n"
+		"{\n"
+		"\tstd::uint64_t hash = 14695981039346656037ull ^ seed_;\n"
+		"\tfor (char ch : name_)\n"
+		"\t{\n"
+		"\t\thash ^= static_cast<unsigned char>(ch);\n"
+		"\t\thash *= 1099511628211ull;\n"
+		"\t}\n"
+		"\thash ^= hash >> 33;\n"
+		"\thash *= 0xff51afd7ed558ccdull;\n"
+		"\thash ^= hash >> 33;\n"
+		"\treturn hash;\n"
+		"}\n\n";
+
+	fmt::format_to(std::back_inserter(output_),
+			"inline constexpr std::size_t lookupSize = {};\n"
+			"inline constexpr std::uint32_t lookupSeeds[{}] = {{",
+			keys.size(),
+			bucketCount
+		);
+	for (size_t i = 0; i < bucketCount; ++i)
+		fmt::format_to(std::back_inserter(output_), "{}{},", (i % 16 == 0) ? "\n\t" : " ", seeds[i]);
+	output_ += "\n};\n\n";
+
+	fmt::format_to(std::back_inserter(output_), "inline constexpr MessageLookupEntry lookupEntries[{}] = {{\n", slotCount);
+	for (auto id : slots)
+	{
+		if (id == NoMessage)
+			output_ += "\t{},\n";
+		else
+		{
+			auto const& name = names_[id];
+			fmt::format_to(std::back_inserter(output_), "\t{{ \"{0}\", {1}, {0}.text.data(), {0}.text.size() }},\n", name, id);
+		}
+	}
+	output_ += "};\n}\n\n";
+
+	fmt::format_to(std::back_inserter(output_),
+			"// Message with the uniqueName, nullptr if there is none:\n"
+			"constexpr internal::MessageLookupEntry const* findMessage(std::string_view uniqueName_)\n"
+			"{{\n"
+			"\tif constexpr (internal::lookupSize == 0)\n"
+			"\t\treturn nullptr;\n\n"
+			"\tauto seed = internal::lookupSeeds[internal::lookupHash(uniqueName_, 0) % {}];\n"
+			"\tauto const& entry = internal::lookupEntries[internal::lookupHash(uniqueName_, seed) % {}];\n"
+			"\treturn (entry.name == uniqueName_) ? &entry : nullptr;\n"
+			"}}\n",
+			bucketCount,
+			slotCount
+		);
+}
+
+////////////////////////////////////////////////
+// Message ids follow input order (or "idRegistry") like the ids of appendNameLookup, so generated
+// per-message code does not depend on them and stays reusable by MessageCache.
+auto appendRuntimeApi(AppOptions const& opts_, LanguageTable const& langs_, std::vector<std::string> const& names_, std::string& output_) -> void
+{
+	if (opts_.emitMode != EmitMode::Classes)
+		return;
+
+	if (opts_.nameLookup)
+		output_ += "\n";
+
+	output_ += "enum class MessageId : std::uint32_t\n{\n";
+	for (size_t id = 0; id < names_.size(); ++id)
+	{
+		if (!names_[id].empty())
+			fmt::format_to(std::back_inserter(output_), "\t{} = {},\n", names_[id], id);
+	}
+	output_ += "};\n\n";
+
+	// Languages by their index in text arrays, nullptr for unused "idRegistry" slots:
+	std::vector<LanguageTable::Language const*> slots(langs_.slots() ? langs_.slots() : langs_.size());
+	for (size_t lang = 0; lang < langs_.size(); ++lang)
+		slots[langs_.slots() ? std::stoul(langs_[lang].index) : lang] = &langs_[lang];
+
+	fmt::format_to(std::back_inserter(output_),
+			"namespace internal {{\n"
+			"inline constexpr std::size_t messageCount\t= {};\n"
+			"inline constexpr std::size_t languageCount\t= {};\n\n"
+			"template <class Text>\n"
+			"constexpr std::string_view textAt(Text const& text_, std::size_t language_)\n"
+			"{{\n"
+			"\treturn language_ < text_.size() ? std::string_view(text_[language_]) : std::string_view();\n"
+			"}}\n\n"
+			"// Texts of all messages, language-major: textTable[language * messageCount + id]\n"
+			"inline constexpr std::array<std::string_view, {}> textTable = ",
+			names_.size(),
+			slots.size(),
+			names_.size() * slots.size()
+		);
+	if (!opts_.languageEnum.empty() && langs_.slots() == 0)
+	{
+		// Rows are indexed by enum values, which only the game knows, so every text is placed by its language:
+		fmt::format_to(std::back_inserter(output_), "[]\n{{\n\tstd::array<std::string_view, {}> table{{}};\n", names_.size() * slots.size());
+		for (size_t lang = 0; lang < langs_.size(); ++lang)
+		{
+			fmt::format_to(std::back_inserter(output_), "\t// {}\n", langs_[lang].id);
+			for (size_t id = 0; id < names_.size(); ++id)
+			{
+				if (!names_[id].empty())
+					fmt::format_to(std::back_inserter(output_), "\ttable[{0} * messageCount + {1}] = textAt({2}.text, {0});\n", langs_[lang].index, id, names_[id]);
+			}
+		}
+		output_ += "\treturn table;\n}();\n\n";
+	}
+	else
+	{
+		output_ += "{{\n";
+		for (size_t lang = 0; lang < slots.size(); ++lang)
+		{
+			output_ += "\t// ";
+			output_ += slots[lang] ? std::string_view(slots[lang]->id) : std::string_view("(unused)");
+			output_ += '\n';
+			for (auto const& name : names_)
+			{
+				if (name.empty() || !slots[lang])
+					output_ += "\t{},\n";
+				else
+					fmt::format_to(std::back_inserter(output_), "\ttextAt({}.text, {}),\n", name, lang);
+			}
+		}
+		output_ += "}};\n\n";
+	}
+
+	output_ += "template <class Message>\nstruct MessageIdOf;\n\n";
+	for (auto const& name : names_)
+	{
+		if (!name.empty())
+			fmt::format_to(std::back_inserter(output_),
+				"template <> struct MessageIdOf<std::remove_const_t<decltype({0})>> {{ static constexpr MessageId value = MessageId::{0}; }};\n", name);
+	}
+	output_ += "}\n\n";
+
+	output_ +=
+		"// Id of a message object, e.g. messageId(Welcome) for MessageId::Welcome:\n"
+		"template <class Message, class = std::enable_if_t<std::is_base_of_v<internal::ChatMessageBase, Message>>>\n"
+		"constexpr MessageId messageId(Message const&)\n"
+		"{\n"
+		"\treturn internal::MessageIdOf<Message>::value;\n"
+		"}\n\n"
+		"// Text of the message in the language, empty if the message has none:\n"
+		"constexpr std::string_view text(MessageId id_, std::size_t language_)\n"
+		"{\n"
+		"\treturn language_ < internal::languageCount\n"
+		"\t\t? internal::textTable[language_ * internal::messageCount + static_cast<std::size_t>(id_)]\n"
+		"\t\t: std::string_view();\n"
+		"}\n\n";
+
+	if (!opts_.languageEnum.empty())
+	{
+		fmt::format_to(std::back_inserter(output_),
+			"constexpr std::string_view text(MessageId id_, {} language_)\n"
+			"{{\n"
+			"\treturn text(id_, static_cast<std::size_t>({}));\n"
+			"}}\n\n",
+			opts_.languageEnum, opts_.languages.empty() ? "language_" : "languageIndex(language_)");
+	}
+
+	output_ +=
+		"// Formats a broadcast once per distinct language instead of once per player.\n"
+		"// playerLanguages_ is a contiguous range of languages (std::vector, std::array, std::span...),\n"
+		"// render_(std::string_view text) formats the text, e.g. with fmt::format(fmt::runtime(text), args...),\n"
+		"// send_(std::size_t player, rendered) is called for every player with a known language, in order.\n"
+		"template <class Languages, class Render, class Send>\n"
+		"void renderForPlayers(MessageId id_, Languages const& playerLanguages_, Render&& render_, Send&& send_)\n"
+		"{\n"
+		"\tusing Rendered = std::decay_t<std::invoke_result_t<Render&, std::string_view>>;\n"
+		"\tstd::array<std::optional<Rendered>, internal::languageCount> rendered;\n\n"
+		"\tfor (std::size_t player = 0; player < playerLanguages_.size(); ++player)\n"
+		"\t{\n"
+		"\t\tauto language = static_cast<std::size_t>(";
+	output_ += (opts_.languages.empty() || opts_.languageEnum.empty()) ? "playerLanguages_[player]" : "languageIndex(playerLanguages_[player])";
+	output_ +=
+		");\n"
+		"\t\tif (language >= internal::languageCount)\n"
+		"\t\t\tcontinue;\n\n"
+		"\t\tauto& result = rendered[language];\n"
+		"\t\tif (!result)\n"
+		"\t\t\tresult.emplace(render_(text(id_, language)));\n"
+		"\t\tsend_(player, *result);\n"
+		"\t}\n"
+		"}\n\n"
+		"template <class Message, class Languages, class Render, class Send,\n"
+		"\tclass = std::enable_if_t<std::is_base_of_v<internal::ChatMessageBase, Message>>>\n"
+		"void renderForPlayers(Message const& message_, Languages const& playerLanguages_, Render&& render_, Send&& send_)\n"
+		"{\n"
+		"\trenderForPlayers(messageId(message_), playerLanguages_, render_, send_);\n"
+		"}\n";
+}
+
+////////////////////////////////////////////////
+// Moves every name to its "idRegistry" id, names_[id] of unused ids are left empty.
+// Skipped elements and repeated names get no id.
+auto assignMessageIds(AppOptions const& opts_, std::vector<std::string>& names_) -> void
+{
+	if (!opts_.idRegistry)
+		return;
+
+	std::vector<std::string> byId;
+	for (auto& name : names_)
+	{
+		if (name.empty())
+			continue;
+
+		size_t id = opts_.idRegistry->messageId(name);
+		if (byId.size() <= id)
+			byId.resize(id + 1);
+		if (byId[id].empty())
+			byId[id] = std::move(name);
+	}
+	byId.resize(opts_.idRegistry->messageCount());
+	names_ = std::move(byId);
+}
+
+////////////////////////////////////////////////
+// With "languages" and "languageEnum" text arrays are indexed by position in the subset,
+// languageIndex() translates enum values of the game, -1 for the languages left out.
+auto appendLanguageIndex(AppOptions const& opts_, LanguageTable const& langs_, std::string& output_) -> void
+{
+	if (opts_.languages.empty() || opts_.languageEnum.empty())
+		return;
+
+	fmt::format_to(std::back_inserter(output_),
+		"// Position of the language in text arrays of this build, -1 for languages it doesn't include:\n"
+		"constexpr int languageIndex({} language_)\n"
+		"{{\n"
+		"\tswitch (language_)\n"
+		"\t{{\n",
+		opts_.languageEnum);
+	for (size_t lang = 0; lang < langs_.size(); ++lang)
+		fmt::format_to(std::back_inserter(output_), "\tcase {}: return {};\n", langs_[lang].enumerator, lang);
+	output_ +=
+		"\tdefault: return -1;\n"
+		"\t}\n"
+		"}\n\n";
+}
+
+////////////////////////////////////////////////
+auto emitChatMessage(AppOptions const& opts_, LanguageTable const& langs_, json const& value_, std::string& output_, MessageCache* cache_, GenerationStats* stats_) -> void
+{
+	size_t size		= output_.size();
+	size_t capacity	= output_.capacity();
+	bool reused		= false;
+
+	if (cache_)
+		reused = cache_->append(langs_, value_, output_);
+	else
+		appendChatMessage(opts_, langs_, value_, output_);
+
+	if (stats_)
+	{
+		stats_->countMessage(value_, output_.size() - size);
+		stats_->cachedMessages += reused ? 1 : 0;
+		if (output_.capacity() != capacity)
+			++stats_->contentReallocations;
+	}
+}
+
+////////////////////////////////////////////////
+auto formatChatMessages(AppOptions const& opts_, LanguageTable const& langs_, std::vector<json const*> const& messages_, GenerationContext const& ctx_, OutputSink& output_) -> void
+{
+	// Small projects are not worth starting threads:
+	constexpr size_t MinMessagesPerJob = 256;
+	size_t jobs = std::min(ctx_.jobs, messages_.size() / MinMessagesPerJob + 1);
+
+	if (jobs <= 1)
+	{
+		// Messages are handed to the output in batches of about ChunkSize bytes:
+		constexpr size_t ChunkSize = 64 * 1024;
+
+		std::string chunk;
+		chunk.reserve(2 * ChunkSize);
+		for (auto message : messages_)
+		{
+			emitChatMessage(opts_, langs_, *message, chunk, ctx_.cache, ctx_.stats);
+			if (chunk.size() >= ChunkSize)
+			{
+				output_.write(chunk);
+				chunk.clear();
+			}
+		}
+		output_.write(chunk);
+		return;
+	}
+
+	// More chunks than threads, so a few long messages don't stall a thread.
+	// Chunks are concatenated in order, so the output is deterministic.
+	size_t chunkCount	= jobs * 8;
+	size_t chunkSize	= (messages_.size() + chunkCount - 1) / chunkCount;
+
+	std::vector<std::string>		chunks(chunkCount);
+	std::vector<GenerationStats>	chunkStats(ctx_.stats ? chunkCount : 0);
+	std::vector<std::exception_ptr>	errors(chunkCount);
+	std::atomic<size_t>				nextChunk{ 0 };
+
+	auto worker = [&]
+	{
+		for (size_t chunk; (chunk = nextChunk++) < chunkCount;)
+		{
+			size_t begin	= std::min(chunk * chunkSize, messages_.size());
+			size_t end		= std::min(begin + chunkSize, messages_.size());
+			try
+			{
+				chunks[chunk].reserve((end - begin) * 1024);
+				for (size_t i = begin; i < end; ++i)
+					emitChatMessage(opts_, langs_, *messages_[i], chunks[chunk], ctx_.cache, ctx_.stats ? &chunkStats[chunk] : nullptr);
+			}
+			catch (...)
+			{
+				errors[chunk] = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(jobs - 1);
+	for (size_t i = 1; i < jobs; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+
+	// Report the error of the first failing message:
+	for (auto const& error : errors)
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	if (ctx_.stats)
+	{
+		for (auto const& stats : chunkStats)
+			ctx_.stats->merge(stats);
+	}
+
+	// Every chunk is released once written:
+	for (auto& chunk : chunks)
+	{
+		output_.write(chunk);
+		std::string().swap(chunk);
+	}
+}
+
+////////////////////////////////////////////////
+// SAX handler used by visitChatJson in streaming mode.
+// Only the "languages" array and a single "chatMessages" element at a time
+// are materialized as JSON values, everything else is skipped.
+class ChatStreamHandler
+	: public nlohmann::json_sax<json>
+{
+public:
+	ChatStreamHandler(AppOptions const& opts_, ChatMessageVisitor const& visitor_, MessageValidator* validator_ = nullptr)
+		: opts(opts_), visitor(visitor_), validator(validator_)
+	{
+	}
+
+	bool null() override							{ return value(nullptr); }
+	bool boolean(bool val_) override				{ return value(val_); }
+	bool number_integer(number_integer_t val_) override		{ return value(val_); }
+	bool number_unsigned(number_unsigned_t val_) override	{ return value(val_); }
+	bool number_float(number_float_t val_, string_t const&) override { return value(val_); }
+	bool string(string_t& val_) override			{ return value(std::move(val_)); }
+	// Binary values never appear in textual JSON:
+	bool binary(binary_t&) override					{ return true; }
+
+	bool start_object(std::size_t) override
+	{
+		++depth;
+		if (depth == 1)
+			return true;
+		return beginContainer(json::object());
+	}
+
+	bool end_object() override
+	{
+		--depth;
+		if (depth == 0)
+			return true;
+		return endContainer();
+	}
+
+	bool start_array(std::size_t) override
+	{
+		++depth;
+		if (depth == 2)
+		{
+			if (currentKey == "chatMessages")
+			{
+				section = Section::ChatMessages;
+				seenChatMessages = true;
+				return true;
+			}
+			if (currentKey == "languages")
+				section = Section::Languages;
+		}
+		return beginContainer(json::array());
+	}
+
+	bool end_array() override
+	{
+		--depth;
+		if (depth == 1 && section == Section::ChatMessages)
+		{
+			section = Section::None;
+			return true;
+		}
+		return endContainer();
+	}
+
+	bool key(string_t& val_) override
+	{
+		if (depth == 1)
+			currentKey = val_;
+		else if (!stack.empty())
+			pendingKey = std::move(val_);
+		return true;
+	}
+
+	bool parse_error(std::size_t, std::string const&, nlohmann::detail::exception const& ex_) override
+	{
+		error = ex_.what();
+		return false;
+	}
+
+	auto languages() -> LanguageTable& { return langs; }
+
+	// Called after the parser finished:
+	void finish(bool parsed_)
+	{
+		if (!parsed_)
+			throw std::runtime_error("Could not parse JSON file - " + error);
+		if (!seenLanguages)
+			throw std::runtime_error("Could not parse JSON file - \"languages\" value is not an array.");
+		if (!seenChatMessages)
+			throw std::runtime_error("Could not parse JSON file - \"chatMessages\" field not exists or is not an array.");
+	}
+
+private:
+	enum class Section
+	{
+		None,
+		Languages,
+		ChatMessages
+	};
+
+	bool value(json&& val_)
+	{
+		if (stack.empty())
+		{
+			// A top-level "languages" value that is not an array:
+			if (depth == 1 && currentKey == "languages")
+				throw std::runtime_error("Could not parse JSON file - \"languages\" value is not an array.");
+
+			// Scalar elements of "chatMessages" are skipped, but still counted by the validator:
+			if (section == Section::ChatMessages && validator)
+				validator->checkMessage(val_, messageIndex++);
+			return true;
+		}
+
+		insert(std::move(val_));
+		return true;
+	}
+
+	bool beginContainer(json&& container_)
+	{
+		if (stack.empty())
+		{
+			// Skip every top-level value that we are not interested in:
+			if (section == Section::None)
+			{
+				if (depth == 2 && currentKey == "languages")
+					throw std::runtime_error("Could not parse JSON file - \"languages\" value is not an array.");
+				return true;
+			}
+
+			current = std::move(container_);
+			stack.push_back(&current);
+			return true;
+		}
+
+		stack.push_back(insert(std::move(container_)));
+		return true;
+	}
+
+	bool endContainer()
+	{
+		if (stack.empty())
+			return true;
+
+		stack.pop_back();
+		if (!stack.empty())
+			return true;
+
+		if (section == Section::Languages)
+		{
+			if (validator)
+				validator->checkLanguages(current);
+			langs = LanguageTable(opts, current);
+			seenLanguages = true;
+			section = Section::None;
+
+			// Flush messages that appeared before the languages:
+			for (auto const& message : pending)
+				visitor(langs, message);
+			pending.clear();
+			pending.shrink_to_fit();
+		}
+		else if (section == Section::ChatMessages)
+		{
+			if (validator && !validator->checkMessage(current, messageIndex++))
+			{
+				current = nullptr;
+				return true;
+			}
+			selectLanguages(opts, current);
+
+			// Messages need the language table only for the language enum, a "languages" subset,
+			// "languageFallbacks" or "idRegistry" slots:
+			if (seenLanguages || !needsLanguages())
+				visitor(langs, current);
+			else
+				pending.push_back(std::move(current));
+		}
+
+		current = nullptr;
+		return true;
+	}
+
+	auto needsLanguages() const -> bool
+	{
+		return !opts.languageEnum.empty() || !opts.languages.empty() || !opts.languageFallbacks.empty() || opts.idRegistry;
+	}
+
+	json* insert(json&& val_)
+	{
+		json& parent = *stack.back();
+		if (parent.is_array())
+		{
+			parent.push_back(std::move(val_));
+			return &parent.back();
+		}
+
+		json& slot = parent[pendingKey];
+		slot = std::move(val_);
+		return &slot;
+	}
+
+	AppOptions const&			opts;
+	ChatMessageVisitor const&	visitor;
+	MessageValidator*			validator;
+
+	LanguageTable		langs;
+	std::vector<json>	pending;
+
+	json				current;
+	std::vector<json*>	stack;
+	std::string			currentKey;
+	std::string			pendingKey;
+	std::string			error;
+	std::size_t			depth			= 0;
+	std::size_t			messageIndex	= 0;
+	Section				section			= Section::None;
+	bool				seenLanguages	= false;
+	bool				seenChatMessages = false;
+};
+
+////////////////////////////////////////////////
+auto visitChatJson(AppOptions const& opts_, std::string_view fileContents_, bool streaming_, ChatMessageVisitor const& visitor_, GenerationContext const& ctx_) -> LanguageTable
+{
+	if (streaming_)
+	{
+		auto visitor = filterUsedMessages(opts_, visitor_, ctx_);
+		ChatStreamHandler handler(opts_, visitor, ctx_.validator);
+		try
+		{
+			handler.finish(json::sax_parse(fileContents_.begin(), fileContents_.end(), &handler));
+		}
+		catch (std::runtime_error const&)
+		{
+			// Problems found so far explain the error better:
+			if (ctx_.validator)
+				ctx_.validator->report();
+			throw;
+		}
+		if (ctx_.validator)
+			ctx_.validator->report();
+		return std::move(handler.languages());
+	}
+
+	json j = json::parse(fileContents_.begin(), fileContents_.end());
+	return visitChatDocument(opts_, j, visitor_, ctx_);
+}
+
+////////////////////////////////////////////////
+auto visitChatDocument(AppOptions const& opts_, json& j, ChatMessageVisitor const& visitor_, GenerationContext const& ctx_) -> LanguageTable
+{
+	if (j.type() != json::value_t::object)
+		throw std::runtime_error("Could not parse JSON file - value is not an object.");
+
+	LanguageTable langs;
+
+	// Read languages:
+	{
+		auto it = j.find("languages");
+		if (it == j.end() || it->type() != json::value_t::array)
+			throw std::runtime_error("Could not parse JSON file - \"languages\" value is not an array.");
+
+		if (ctx_.validator)
+			ctx_.validator->checkLanguages(*it);
+		langs = LanguageTable(opts_, *it);
+	}
+
+	// Read chat messages:
+	{
+		auto it = j.find("chatMessages");
+		if (it == j.end() || it->type() != json::value_t::array)
+			throw std::runtime_error("Could not parse JSON file - \"chatMessages\" field not exists or is not an array.");
+		
+		// Nothing is emitted for a project with problems:
+		if (ctx_.validator)
+		{
+			ctx_.validator->checkMessages(*it, ctx_.jobs);
+			ctx_.validator->report();
+		}
+
+		auto visitor = filterUsedMessages(opts_, visitor_, ctx_);
+		for(auto& [key, value] : it->items())
+		{
+			selectLanguages(opts_, value);
+			visitor(langs, value);
+		}
+	}
+
+	return langs;
+}
+
+////////////////////////////////////////////////
+// Skips messages whose uniqueName is not in "usedMessages".
+// Malformed entries are passed through, so that emission still reports them.
+auto filterUsedMessages(AppOptions const& opts_, ChatMessageVisitor const& visitor_, GenerationContext const& ctx_) -> ChatMessageVisitor
+{
+	if (!opts_.usedMessages)
+		return visitor_;
+
+	return [&opts_, &visitor_, unused = ctx_.unusedMessages](LanguageTable const& langs_, json const& message_)
+	{
+		auto name = chatMessageName(message_);
+		if (name.empty() || opts_.usedMessages->count(std::string(name)) != 0)
+		{
+			visitor_(langs_, message_);
+			return;
+		}
+
+		if (unused)
+			unused->emplace_back(name);
+	};
+}
+
+////////////////////////////////////////////////
+// Rewrites "content" of the message to the languages selected with "languages",
+// filling texts missing in a language from its "languageFallbacks" chain.
+// Malformed messages are left as they are, emission reports them.
+auto selectLanguages(AppOptions const& opts_, json& message_) -> void
+{
+	if (opts_.languages.empty() && opts_.languageFallbacks.empty())
+		return;
+
+	if (message_.type() != json::value_t::object)
+		return;
+
+	auto contentIt = message_.find("content");
+	if (contentIt == message_.end() || contentIt->type() != json::value_t::object)
+		return;
+
+	auto& content = *contentIt;
+	auto resolve = [&](std::string const& langId_) -> json const*
+	{
+		auto textIt = content.find(langId_);
+		if (textIt != content.end())
+			return &*textIt;
+
+		auto chainIt = opts_.languageFallbacks.find(langId_);
+		if (chainIt == opts_.languageFallbacks.end())
+			return nullptr;
+
+		for (auto const& fallback : chainIt->second)
+		{
+			textIt = content.find(fallback);
+			if (textIt != content.end())
+				return &*textIt;
+		}
+		return nullptr;
+	};
+
+	if (opts_.languages.empty())
+	{
+		for (auto const& [langId, _] : opts_.languageFallbacks)
+		{
+			if (content.contains(langId))
+				continue;
+
+			if (auto text = resolve(langId))
+			{
+				json copy = *text;
+				content[langId] = std::move(copy);
+			}
+		}
+		return;
+	}
+
+	json selected = json::object();
+	for (auto const& langId : opts_.languages)
+	{
+		if (auto text = resolve(langId))
+			selected[langId] = *text;
+	}
+	content = std::move(selected);
+}
+
+////////////////////////////////////////////////
+auto collectChatProject(AppOptions const& opts_, std::string_view fileContents_, bool streaming_, GenerationContext const& ctx_) -> ChatProject
+{
+	ChatProject project;
+
+	project.langs = visitChatJson(opts_, fileContents_, streaming_,
+		[&](LanguageTable const&, json const& value_)
+		{
+			if (value_.type() != json::value_t::object)
+				return;
+
+			auto nameIt		= value_.find("uniqueName");
+			auto contentIt	= value_.find("content");
+			if (nameIt == value_.end() || contentIt == value_.end())
+				return;
+
+			if (!nameIt->is_string())
+				throw std::runtime_error("Could not parse JSON file - chat message \"uniqueName\" is not a string.");
+			if (!contentIt->is_object())
+				throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" has \"content\" that is not an object.", nameIt->get_ref<std::string const&>()));
+
+			ChatMessage message;
+			message.uniqueName = nameIt->get_ref<std::string const&>();
+			message.texts.reserve(contentIt->size());
+			for (auto const& [langId, msgContent] : contentIt->items())
+			{
+				// Load first comment-version of a message as a comment:
+				if (message.comment.empty())
+					message.comment = messageText(msgContent, "comment", message.uniqueName, langId);
+
+				message.texts.emplace_back(langId, messageText(msgContent, "processed", message.uniqueName, langId));
+			}
+			project.messages.push_back(std::move(message));
+		}, ctx_);
+
+	return project;
+}
+
+////////////////////////////////////////////////
+// Bytes that a string literal body stands for once escape sequences are processed.
+static auto unescapeLiteral(std::string_view body_, std::string_view uniqueName_, std::string_view langId_) -> std::string
+{
+	auto error = [&](char const* what_)
+	{
+		return std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" in \"{}\" has an invalid escape sequence: {}.", uniqueName_, langId_, what_));
+	};
+	auto isOctal = [](char ch_) { return ch_ >= '0' && ch_ <= '7'; };
+	auto hexValue = [](char ch_) -> unsigned
+	{
+		return (ch_ >= '0' && ch_ <= '9') ? ch_ - '0' : (std::tolower(static_cast<unsigned char>(ch_)) - 'a' + 10);
+	};
+	auto isHex = [](char ch_) { return std::isxdigit(static_cast<unsigned char>(ch_)) != 0; };
+
+	std::string bytes;
+	bytes.reserve(body_.size());
+	for (size_t i = 0; i < body_.size(); ++i)
+	{
+		if (body_[i] != '\\' || i + 1 == body_.size())
+		{
+			bytes += body_[i];
+			continue;
+		}
+
+		char ch = body_[++i];
+		switch (ch)
+		{
+		case 'n':	bytes += '\n'; break;
+		case 't':	bytes += '\t'; break;
+		case 'r':	bytes += '\r'; break;
+		case 'a':	bytes += '\a'; break;
+		case 'b':	bytes += '\b'; break;
+		case 'f':	bytes += '\f'; break;
+		case 'v':	bytes += '\v'; break;
+		case 'x':
+		{
+			if (i + 1 == body_.size() || !isHex(body_[i + 1]))
+				throw error("'\\x' without hexadecimal digits");
+
+			unsigned value = 0;
+			while (i + 1 < body_.size() && isHex(body_[i + 1]))
+			{
+				value = value * 16 + hexValue(body_[++i]);
+				if (value > 0xFF)
+					throw error("'\\x' value does not fit in a byte");
+			}
+			bytes += static_cast<char>(value);
+			break;
+		}
+		case 'u':
+		case 'U':
+		{
+			// Universal character names are stored as UTF-8:
+			size_t digits = (ch == 'u') ? 4 : 8;
+			if (body_.size() - (i + 1) < digits || !std::all_of(body_.begin() + i + 1, body_.begin() + i + 1 + digits, isHex))
+				throw error(ch == 'u' ? "'\\u' needs 4 hexadecimal digits" : "'\\U' needs 8 hexadecimal digits");
+
+			unsigned long cp = 0;
+			for (size_t n = 0; n < digits; ++n)
+				cp = cp * 16 + hexValue(body_[++i]);
+			if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+				throw error("universal character name is not a valid code point");
+			if (cp < 0x80)
+				bytes += static_cast<char>(cp);
+			else if (cp < 0x800)
+			{
+				bytes += static_cast<char>(0xC0 | (cp >> 6));
+				bytes += static_cast<char>(0x80 | (cp & 0x3F));
+			}
+			else if (cp < 0x10000)
+			{
+				bytes += static_cast<char>(0xE0 | (cp >> 12));
+				bytes += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+				bytes += static_cast<char>(0x80 | (cp & 0x3F));
+			}
+			else
+			{
+				bytes += static_cast<char>(0xF0 | (cp >> 18));
+				bytes += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+				bytes += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+				bytes += static_cast<char>(0x80 | (cp & 0x3F));
+			}
+			break;
+		}
+		default:
+			if (isOctal(ch))
+			{
+				unsigned value = static_cast<unsigned>(ch - '0');
+				for (int n = 1; n < 3 && i + 1 < body_.size() && isOctal(body_[i + 1]); ++n)
+					value = value * 8 + static_cast<unsigned>(body_[++i] - '0');
+				bytes += static_cast<char>(value);
+			}
+			else
+				bytes += ch; // \\, \", \', \?
+			break;
+		}
+	}
+	return bytes;
+}
+
+////////////////////////////////////////////////
+// Appends bytes as a string literal body. Control characters use 3-digit octal escapes,
+// so they can't run into the following characters.
+static auto appendEscapedLiteral(std::string_view bytes_, std::string& output_, bool escapeHighBytes_ = false) -> void
+{
+	for (char ch : bytes_)
+	{
+		auto uch = static_cast<unsigned char>(ch);
+		switch (ch)
+		{
+		case '"':	output_ += "\\\""; break;
+		case '\\':	output_ += "\\\\"; break;
+		case '\n':	output_ += "\\n"; break;
+		case '\t':	output_ += "\\t"; break;
+		case '\r':	output_ += "\\r"; break;
+		default:
+			if (uch < 0x20 || uch == 0x7F || (escapeHighBytes_ && uch >= 0x80))
+				fmt::format_to(std::back_inserter(output_), "\\{:03o}", uch);
+			else
+				output_ += ch;
+			break;
+		}
+	}
+}
+
+////////////////////////////////////////////////
+// Bytes of a "processed" text, see "escapeStrings" and "languageEncodings".
+// Texts are transcoded before escape sequences are processed, bytes written as escapes are kept.
+auto literalBytes(AppOptions const& opts_, std::string const& text_, Codepage const* codepage_, std::string_view uniqueName_, std::string_view langId_) -> std::string
+{
+	if (codepage_)
+	{
+		std::string encoded;
+		encodeText(*codepage_, text_, uniqueName_, encoded);
+		return opts_.escapeStrings ? encoded : unescapeLiteral(encoded, uniqueName_, langId_);
+	}
+	return opts_.escapeStrings ? text_ : unescapeLiteral(text_, uniqueName_, langId_);
+}
+
+////////////////////////////////////////////////
+// Codepage of the language, nullptr for UTF-8 (no "languageEncodings" entry).
+auto languageCodepage(AppOptions const& opts_, std::string_view langId_) -> Codepage const*
+{
+	if (opts_.languageEncodings.empty())
+		return nullptr;
+
+	auto it = opts_.languageEncodings.find(langId_);
+	return it == opts_.languageEncodings.end() ? nullptr : Codepage::find(it->second);
+}
+
+////////////////////////////////////////////////
+auto encodeText(Codepage const& codepage_, std::string_view text_, std::string_view uniqueName_, std::string& output_) -> void
+{
+	size_t pos = codepage_.encode(text_, output_);
+	if (pos == std::string_view::npos)
+		return;
+
+	size_t end = pos + 1;
+	while (end < text_.size() && (static_cast<unsigned char>(text_[end]) & 0xC0) == 0x80)
+		++end;
+	throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" has a text that can't be encoded in {}: \"{}\" at byte {}.",
+		uniqueName_, codepage_.name(), text_.substr(pos, end - pos), pos));
+}
+
+////////////////////////////////////////////////
+// Replaces bytes 0x80-0xFF after begin_ with octal escapes, they are not valid UTF-8 in a codepage text.
+// Octal escapes end after three digits, so following text can't extend them.
+auto escapeHighBytes(std::string& output_, size_t begin_) -> void
+{
+	auto isHigh = [](char ch_) { return static_cast<unsigned char>(ch_) >= 0x80; };
+
+	auto first = std::find_if(output_.begin() + begin_, output_.end(), isHigh);
+	if (first == output_.end())
+		return;
+
+	std::string tail(first, output_.end());
+	output_.erase(first, output_.end());
+	for (char ch : tail)
+	{
+		if (isHigh(ch))
+			fmt::format_to(std::back_inserter(output_), "\\{:03o}", static_cast<unsigned char>(ch));
+		else
+			output_ += ch;
+	}
+}
+
+////////////////////////////////////////////////
+// Position of the first byte at or after pos_ that can't be copied into a string literal as is:
+// '"', '\\' or a control character. Returns text_.size() when there is none.
+// Texts rarely contain such bytes, so 16 bytes are classified at once where SIMD is available.
+auto findLiteralSpecial(std::string_view text_, size_t pos_) -> size_t
+{
+	auto isSpecial = [](char ch_)
+	{
+		auto uch = static_cast<unsigned char>(ch_);
+		return ch_ == '"' || ch_ == '\\' || uch < 0x20 || uch == 0x7F;
+	};
+
+	size_t i = pos_;
+#if defined(SAMP_CT_SSE2)
+	__m128i const quote		= _mm_set1_epi8('"');
+	__m128i const backslash	= _mm_set1_epi8('\\');
+	__m128i const lastCtrl	= _mm_set1_epi8(0x1F);
+	__m128i const del		= _mm_set1_epi8(0x7F);
+	for (; i + 16 <= text_.size(); i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(text_.data() + i));
+
+		// Unsigned chunk <= 0x1F exactly when min(chunk, 0x1F) == chunk:
+		__m128i control	= _mm_cmpeq_epi8(_mm_min_epu8(chunk, lastCtrl), chunk);
+		__m128i special	= _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+			_mm_or_si128(control, _mm_cmpeq_epi8(chunk, del)));
+
+		auto mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+		if (mask != 0)
+		{
+#ifdef _MSC_VER
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+			return i + bit;
+#else
+			return i + static_cast<size_t>(__builtin_ctz(mask));
+#endif
+		}
+	}
+#elif defined(SAMP_CT_NEON)
+	uint8x16_t const quote		= vdupq_n_u8('"');
+	uint8x16_t const backslash	= vdupq_n_u8('\\');
+	uint8x16_t const space		= vdupq_n_u8(0x20);
+	uint8x16_t const del		= vdupq_n_u8(0x7F);
+	for (; i + 16 <= text_.size(); i += 16)
+	{
+		uint8x16_t chunk = vld1q_u8(reinterpret_cast<uint8_t const*>(text_.data() + i));
+		uint8x16_t special = vorrq_u8(
+			vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)),
+			vorrq_u8(vcltq_u8(chunk, space), vceqq_u8(chunk, del)));
+
+		// Found somewhere in these 16 bytes, the scalar loop below finds where:
+		if (vmaxvq_u8(special) != 0)
+			break;
+	}
+#endif
+
+	for (; i < text_.size(); ++i)
+	{
+		if (isSpecial(text_[i]))
+			return i;
+	}
+	return text_.size();
+}
+
+////////////////////////////////////////////////
+// Appends text_ as the body of a string literal.
+// Runs without special bytes are copied at once, so texts that need no escaping cost one scan and one copy.
+auto appendLiteralText(AppOptions const& opts_, std::string_view text_, std::string_view uniqueName_, std::string& output_, Codepage const* codepage_) -> void
+{
+	if (codepage_)
+	{
+		// Reused by every text transcoded on this thread:
+		thread_local std::string encoded;
+		encoded.clear();
+		encodeText(*codepage_, text_, uniqueName_, encoded);
+
+		size_t begin = output_.size();
+		appendLiteralText(opts_, encoded, uniqueName_, output_);
+		escapeHighBytes(output_, begin);
+		return;
+	}
+
+	auto error = [&](char const* what_)
+	{
+		return std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" has a text that is not a valid string literal: {} (enable \"escapeStrings\" to escape it).", uniqueName_, what_));
+	};
+
+	size_t begin = 0;
+	for (;;)
+	{
+		size_t pos = findLiteralSpecial(text_, begin);
+		output_.append(text_.data() + begin, pos - begin);
+		if (pos == text_.size())
+			return;
+
+		char ch = text_[pos];
+		begin = pos + 1;
+
+		if (opts_.escapeStrings)
+		{
+			appendEscapedLiteral(text_.substr(pos, 1), output_);
+			continue;
+		}
+
+		// Texts are literal bodies, keep escape sequences and reject what would end the literal:
+		if (ch == '\\')
+		{
+			if (pos + 1 == text_.size() || text_[pos + 1] == '\n' || text_[pos + 1] == '\r')
+				throw error("'\\' at the end of the text or line");
+			output_.append(text_.data() + pos, 2);
+			begin = pos + 2;
+		}
+		else if (ch == '"')
+			throw error("unescaped '\"'");
+		else if (ch == '\n' || ch == '\r')
+			throw error("line break");
+		else
+			output_ += ch;
+	}
+}
+
+////////////////////////////////////////////////
+// Appends text_ to a single-line comment, line breaks would end it.
+auto appendCommentText(std::string_view text_, std::string& output_) -> void
+{
+	for (char ch : text_)
+		output_ += (ch == '\n' || ch == '\r') ? ' ' : ch;
+}
+
+////////////////////////////////////////////////
+// Lays out NUL-terminated strings in one blob.
+// Identical strings can be pooled and strings that are suffixes of others can point into them.
+class StringBlob
+{
+public:
+	StringBlob(bool deduplicate_, bool shareSuffixes_, bool escapeHighBytes_ = false)
+		: deduplicate(deduplicate_), shareSuffixes(shareSuffixes_), escapeHighBytes(escapeHighBytes_)
+	{
+	}
+
+	// Returns id of the string, offsets are known after layout():
+	auto add(std::string bytes_, std::string_view label_) -> size_t
+	{
+		if (deduplicate)
+		{
+			auto it = ids.find(bytes_);
+			if (it != ids.end())
+				return it->second;
+			ids.emplace(bytes_, strings.size());
+		}
+
+		strings.push_back(Entry{ std::move(bytes_), std::string(label_), 0 });
+		return strings.size() - 1;
+	}
+
+	auto layout() -> void
+	{
+		std::vector<size_t> owners(strings.size());
+		for (size_t i = 0; i < strings.size(); ++i)
+			owners[i] = i;
+
+		if (shareSuffixes && !strings.empty())
+		{
+			// Sorted by reversed contents, a suffix is always followed by the strings that end with it:
+			std::vector<size_t> order(owners);
+			std::sort(order.begin(), order.end(),
+				[&](size_t lhs_, size_t rhs_)
+				{
+					auto const& lhs = strings[lhs_].bytes;
+					auto const& rhs = strings[rhs_].bytes;
+					return std::lexicographical_compare(lhs.rbegin(), lhs.rend(), rhs.rbegin(), rhs.rend());
+				});
+
+			for (size_t i = order.size() - 1; i-- > 0;)
+			{
+				auto const& shorter	= strings[order[i]].bytes;
+				auto const& longer	= strings[order[i + 1]].bytes;
+				if (longer.size() >= shorter.size() && longer.compare(longer.size() - shorter.size(), shorter.size(), shorter) == 0)
+					owners[order[i]] = owners[order[i + 1]];
+			}
+		}
+
+		size = 0;
+		literal.clear();
+		for (size_t i = 0; i < strings.size(); ++i)
+		{
+			if (owners[i] != i)
+				continue;
+
+			strings[i].offset = size;
+			size += strings[i].bytes.size() + 1;
+
+			// Every string is a separate literal piece:
+			literal += "\t\"";
+			appendEscapedLiteral(strings[i].bytes, literal, escapeHighBytes);
+			literal += "\\0\"\t// ";
+			literal += strings[i].label;
+			literal += '\n';
+		}
+
+		for (size_t i = 0; i < strings.size(); ++i)
+		{
+			auto const& owner = strings[owners[i]];
+			strings[i].offset = owner.offset + owner.bytes.size() - strings[i].bytes.size();
+		}
+	}
+
+	auto offset(size_t id_) const -> size_t	{ return strings[id_].offset; }
+	auto length(size_t id_) const -> size_t	{ return strings[id_].bytes.size(); }
+
+	// Raw contents of the blob, strings sharing a suffix are written over each other:
+	auto bytes() const -> std::string
+	{
+		std::string blob(size, '\0');
+		for (auto const& str : strings)
+			std::memcpy(blob.data() + str.offset, str.bytes.data(), str.bytes.size());
+		return blob;
+	}
+
+	// Body of the blob definition, one literal piece per line:
+	auto pieces() const -> std::string_view	{ return literal.empty() ? std::string_view("\t\"\"\n") : std::string_view(literal); }
+
+private:
+	struct Entry
+	{
+		std::string	bytes;
+		std::string	label;
+		size_t		offset;
+	};
+
+	bool							deduplicate;
+	bool							shareSuffixes;
+	bool							escapeHighBytes;	// Codepage texts are not valid UTF-8
+	std::vector<Entry>				strings;
+	std::unordered_map<std::string, size_t> ids;
+	std::string						literal;
+	size_t							size = 0;
+};
+
+////////////////////////////////////////////////
+auto emitStringTable(AppOptions const& opts_, ChatProject const& project_) -> std::string
+{
+	// Language columns, sorted by id like keys of the "content" objects:
+	std::map<std::string, size_t> columns;
+	for (auto const& message : project_.messages)
+	{
+		for (auto const& [langId, text] : message.texts)
+			columns.try_emplace(langId, 0);
+	}
+	{
+		size_t column = 0;
+		for (auto& [langId, index] : columns)
+			index = column++;
+	}
+
+	// Pooled strings share one blob across all languages:
+	bool deduplicate = opts_.deduplicateStrings || opts_.shareSuffixes;
+	std::vector<StringBlob> blobs(deduplicate ? 1 : columns.size(), StringBlob(deduplicate, opts_.shareSuffixes, !opts_.languageEncodings.empty()));
+	auto blobIndex = [&](size_t column_) { return deduplicate ? 0 : column_; };
+
+	// Message ids follow input order, or come from "idRegistry" with unused ids left empty:
+	std::vector<size_t> messageIds(project_.messages.size());
+	for (size_t i = 0; i < messageIds.size(); ++i)
+		messageIds[i] = opts_.idRegistry ? opts_.idRegistry->messageId(project_.messages[i].uniqueName) : i;
+	size_t messageCount = opts_.idRegistry ? opts_.idRegistry->messageCount() : project_.messages.size();
+
+	constexpr size_t NoString = ~size_t(0);
+	std::vector< std::vector<size_t> > indexes(columns.size(), std::vector<size_t>(messageCount, NoString));
+
+	for (size_t i = 0; i < project_.messages.size(); ++i)
+	{
+		auto const& message = project_.messages[i];
+		for (auto const& [langId, text] : message.texts)
+		{
+			size_t column = columns[langId];
+			indexes[column][messageIds[i]] = blobs[blobIndex(column)].add(literalBytes(opts_, text, languageCodepage(opts_, langId), message.uniqueName, langId), message.uniqueName);
+		}
+	}
+
+	for (auto& blob : blobs)
+		blob.layout();
+
+	std::string output;
+	output.reserve(1 * 1024 * 1024);
+
+	appendIncludes(opts_, output);
+	output += "#include <array>\n#include <cstdint>\n#include <string_view>\n\n\n";
+	appendNamespaceBegin(opts_, output);
+	appendLanguageIndex(opts_, project_.langs, output);
+
+	output += "namespace internal {\nstruct ChatMessageBase {};\n\n";
+	output +=
+		"struct StringRef\n"
+		"{\n"
+		"\tstd::uint32_t offset;\n"
+		"\tstd::uint32_t length;\n"
+		"};\n\n"
+		"struct StringTable\n"
+		"{\n"
+		"\tchar const*\t\tblob;\n"
+		"\tStringRef const*\tindex;\n"
+		"};\n\n";
+
+	fmt::format_to(std::back_inserter(output),
+			"inline constexpr std::size_t languageCount = {};\n"
+			"inline constexpr std::size_t messageCount = {};\n\n",
+			project_.langs.slots() ? project_.langs.slots() : columns.size(),
+			messageCount
+		);
+
+	if (deduplicate)
+	{
+		output += "inline constexpr char stringBlob[] =\n";
+		output += blobs[0].pieces();
+		output += "\t;\n\n";
+	}
+
+	for (auto const& [langId, column] : columns)
+	{
+		auto const& blob = blobs[blobIndex(column)];
+		if (!deduplicate)
+		{
+			fmt::format_to(std::back_inserter(output), "// \"{}\"\ninline constexpr char stringBlob{}[] =\n", langId, column);
+			output += blob.pieces();
+			output += "\t;\n\n";
+		}
+		else
+			fmt::format_to(std::back_inserter(output), "// \"{}\"\n", langId);
+
+		fmt::format_to(std::back_inserter(output), "inline constexpr StringRef stringIndex{}[{}] = {{\n", column, std::max<size_t>(messageCount, 1));
+		for (auto id : indexes[column])
+		{
+			if (id == NoString)
+				output += "\t{ 0, 0 },\n";
+			else
+				fmt::format_to(std::back_inserter(output), "\t{{ {}, {} }},\n", blob.offset(id), blob.length(id));
+		}
+		output += "};\n\n";
+	}
+
+	output += "inline constexpr auto stringTables = []\n{\n";
+	fmt::format_to(std::back_inserter(output), "\tstd::array<StringTable, {}> result{{}};\n", project_.langs.slots() ? project_.langs.slots() : columns.size());
+	for (auto const& [langId, column] : columns)
+	{
+		output += "\tresult[";
+		if (opts_.languageEnum.empty() && project_.langs.slots() == 0)
+			output += std::to_string(column);
+		else
+		{
+			auto lang = project_.langs.find(langId);
+			if (!lang)
+				throw std::runtime_error(fmt::format("Could not parse JSON file - chat messages use unknown language \"{}\".", langId));
+			output += lang->index;
+		}
+		if (deduplicate)
+			fmt::format_to(std::back_inserter(output), "] = StringTable{{ stringBlob, stringIndex{} }};\n", column);
+		else
+			fmt::format_to(std::back_inserter(output), "] = StringTable{{ stringBlob{0}, stringIndex{0} }};\n", column);
+	}
+	output += "\treturn result;\n}();\n}\n\n";
+
+	output +=
+		"struct ChatMessage\n"
+		"\t: public internal::ChatMessageBase\n"
+		"{\n"
+		"\tstd::uint32_t id;\n\n"
+		"\tconstexpr std::string_view text(std::size_t lang_) const\n"
+		"\t{\n"
+		"\t\tauto const& table = internal::stringTables[lang_];\n";
+	// Unused "idRegistry" slots and selected languages without texts have no table:
+	if (project_.langs.slots())
+		output += "\t\tif (!table.index)\n\t\t\treturn {};\n";
+	output +=
+		"\t\tauto const& ref = table.index[id];\n"
+		"\t\treturn std::string_view(table.blob + ref.offset, ref.length);\n"
+		"\t}\n"
+		"};\n\n";
+
+	for (size_t i = 0; i < project_.messages.size(); ++i)
+	{
+		auto const& message = project_.messages[i];
+		output += "// \"";
+		appendCommentText(message.comment, output);
+		fmt::format_to(std::back_inserter(output), "\"\ninline constexpr ChatMessage {}{{ {{}}, {} }};\n\n", message.uniqueName, messageIds[i]);
+	}
+
+	appendEpilogue(opts_, output);
+	return output;
+}
+
+////////////////////////////////////////////////
+auto emitCatalog(AppOptions const& opts_, ChatProject const& project_) -> std::string
+{
+	using namespace samp_ct;
+
+	// Language columns, sorted by id like keys of the "content" objects:
+	std::map<std::string, size_t> columns;
+	for (auto const& message : project_.messages)
+	{
+		for (auto const& [langId, text] : message.texts)
+			columns.try_emplace(langId, 0);
+	}
+	{
+		size_t column = 0;
+		for (auto& [langId, index] : columns)
+			index = column++;
+	}
+
+	StringBlob blob(opts_.deduplicateStrings || opts_.shareSuffixes, opts_.shareSuffixes);
+
+	std::vector< std::pair<size_t, size_t> > languages;
+	for (auto const& [langId, column] : columns)
+	{
+		auto lang = project_.langs.find(langId);
+		languages.emplace_back(blob.add(langId, "language id"), blob.add(lang ? lang->name : std::string{}, "language name"));
+	}
+
+	// Index entries sorted by name hash, ties by name so the output is deterministic:
+	size_t messageCount = project_.messages.size();
+	std::vector<size_t> order(messageCount);
+	std::vector<uint64_t> hashes(messageCount);
+	for (size_t id = 0; id < messageCount; ++id)
+	{
+		order[id]	= id;
+		hashes[id]	= hashName(project_.messages[id].uniqueName);
+	}
+	std::sort(order.begin(), order.end(),
+		[&](size_t lhs_, size_t rhs_)
+		{
+			if (hashes[lhs_] != hashes[rhs_])
+				return hashes[lhs_] < hashes[rhs_];
+			return project_.messages[lhs_].uniqueName < project_.messages[rhs_].uniqueName;
+		});
+
+	constexpr size_t NoString = ~size_t(0);
+	std::vector<size_t> names(messageCount);
+	std::vector<size_t> texts(messageCount * columns.size(), NoString);
+	for (size_t row = 0; row < messageCount; ++row)
+	{
+		auto const& message = project_.messages[order[row]];
+		names[row] = blob.add(message.uniqueName, message.uniqueName);
+		for (auto const& [langId, text] : message.texts)
+			texts[row * columns.size() + columns[langId]] = blob.add(literalBytes(opts_, text, languageCodepage(opts_, langId), message.uniqueName, langId), message.uniqueName);
+	}
+	blob.layout();
+
+	// About one message per bucket:
+	uint32_t bucketBits = 1;
+	while (bucketBits < 24 && (size_t(1) << bucketBits) < messageCount)
+		++bucketBits;
+
+	std::vector<uint32_t> buckets((size_t(1) << bucketBits) + 1, 0);
+	for (size_t row = 0; row < messageCount; ++row)
+		++buckets[(hashes[order[row]] >> (64 - bucketBits)) + 1];
+	for (size_t i = 1; i < buckets.size(); ++i)
+		buckets[i] += buckets[i - 1];
+
+	auto blobBytes = blob.bytes();
+
+	std::string output;
+	auto align = [&] { output.resize((output.size() + 7) / 8 * 8, '\0'); };
+	auto append = [&](void const* src_, size_t size_) { output.append(static_cast<char const*>(src_), size_); };
+	auto ref = [&](size_t id_)
+	{
+		if (id_ == NoString)
+			return CatalogString{ CatalogString::NoString, 0 };
+		return CatalogString{ static_cast<uint32_t>(blob.offset(id_)), static_cast<uint32_t>(blob.length(id_)) };
+	};
+
+	CatalogHeader header{};
+	std::memcpy(header.magic, CatalogMagic, sizeof(CatalogMagic));
+	header.version			= CatalogVersion;
+	header.languageCount	= static_cast<uint32_t>(columns.size());
+	header.messageCount		= static_cast<uint32_t>(messageCount);
+	header.bucketBits		= bucketBits;
+	append(&header, sizeof(header));
+
+	align();
+	header.languagesOffset = static_cast<uint32_t>(output.size());
+	for (auto const& [id, name] : languages)
+	{
+		CatalogLanguage language{ ref(id), ref(name) };
+		append(&language, sizeof(language));
+	}
+
+	align();
+	header.bucketsOffset = static_cast<uint32_t>(output.size());
+	append(buckets.data(), buckets.size() * sizeof(uint32_t));
+
+	align();
+	header.indexOffset = static_cast<uint32_t>(output.size());
+	for (size_t row = 0; row < messageCount; ++row)
+	{
+		CatalogMessage message{ hashes[order[row]], ref(names[row]) };
+		append(&message, sizeof(message));
+	}
+
+	align();
+	header.textsOffset = static_cast<uint32_t>(output.size());
+	for (auto id : texts)
+	{
+		auto text = ref(id);
+		append(&text, sizeof(text));
+	}
+
+	align();
+	header.blobOffset	= static_cast<uint32_t>(output.size());
+	header.blobSize		= static_cast<uint32_t>(blobBytes.size());
+	output += blobBytes;
+
+	if (output.size() >= CatalogString::NoString)
+		throw std::runtime_error("Could not generate chat catalog - catalog is larger than 4 GiB.");
+
+	header.fileSize = static_cast<uint32_t>(output.size());
+	std::memcpy(output.data(), &header, sizeof(header));
+	return output;
+}
+
+////////////////////////////////////////////////
+// Name of the shard that chat message belongs to, see AppOptions::shardBy.
+static auto shardKey(AppOptions const& opts_, json const& message_, size_t index_) -> std::string
+{
+	std::string key;
+	switch (opts_.shardBy)
+	{
+	case ShardMode::Count:
+		key = std::to_string(index_ / std::max<size_t>(opts_.shardSize, 1));
+		break;
+	case ShardMode::Prefix:
+	{
+		auto it = message_.find("uniqueName");
+		if (it != message_.end() && it->is_string())
+		{
+			auto const& name = it->get_ref<std::string const&>();
+			auto sep = opts_.shardPrefixSeparator.empty() ? std::string::npos : name.find(opts_.shardPrefixSeparator);
+			if (sep != std::string::npos && sep > 0)
+				key = name.substr(0, sep);
+		}
+		break;
+	}
+	case ShardMode::Category:
+	{
+		auto it = message_.find("category");
+		if (it != message_.end() && it->is_string())
+			key = it->get<std::string>();
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (key.empty())
+		return "default";
+
+	// Shard names become part of file names:
+	for (auto& ch : key)
+	{
+		if (!std::isalnum(static_cast<unsigned char>(ch)) && ch != '_')
+			ch = '_';
+	}
+	return key;
+}
+
+////////////////////////////////////////////////
+auto shardChatJson(AppOptions const& opts_, std::string_view fileContents_, bool streaming_, std::string_view outputPath_, GenerationContext const& ctx_) -> std::vector<OutputFile>
+{
+	namespace fs = std::filesystem;
+
+	// Shard contents in order of the first appearance:
+	std::vector< std::pair<std::string, std::string> > shards;
+	std::map<std::string, size_t> shardIndices;
+
+	// All names in input order, for the lookup table and the runtime API in the umbrella header:
+	std::vector<std::string> names;
+	LanguageTable langs;
+
+	size_t messageIndex = 0;
+	auto shardOf = [&](json const& message_) -> size_t
+	{
+		if (opts_.nameLookup || opts_.runtimeApi)
+			names.emplace_back(chatMessageName(message_));
+
+		auto key = shardKey(opts_, message_, messageIndex++);
+		auto [it, inserted] = shardIndices.try_emplace(key, shards.size());
+		if (inserted)
+			shards.emplace_back(std::move(key), std::string{});
+
+		return it->second;
+	};
+
+	Stopwatch stopwatch;
+	if (streaming_)
+	{
+		langs = visitChatJson(opts_, fileContents_, true,
+			[&](LanguageTable const& langs_, json const& message_)
+			{
+				auto& shard = shards[shardOf(message_)].second;
+				size_t capacity = shard.capacity();
+				emitChatMessage(opts_, langs_, message_, shard, ctx_.cache, ctx_.stats);
+
+				// Messages are formatted straight into the shard, so its growth is output growth:
+				if (ctx_.stats && shard.capacity() != capacity)
+				{
+					--ctx_.stats->contentReallocations;
+					++ctx_.stats->outputReallocations;
+				}
+			}, ctx_);
+
+		if (ctx_.stats)
+			ctx_.stats->languages = langs.size();
+	}
+	else
+	{
+		json j = json::parse(fileContents_.begin(), fileContents_.end());
+
+		// Messages of every shard, in original order:
+		std::vector< std::vector<json const*> > shardMessages;
+		langs = visitChatDocument(opts_, j,
+			[&](LanguageTable const&, json const& message_)
+			{
+				size_t shard = shardOf(message_);
+				shardMessages.resize(shards.size());
+				shardMessages[shard].push_back(&message_);
+			}, ctx_);
+
+		if (ctx_.stats)
+		{
+			ctx_.stats->parse		+= stopwatch.lap();
+			ctx_.stats->languages	= langs.size();
+		}
+
+		for (size_t i = 0; i < shards.size(); ++i)
+		{
+			StringSink sink(shards[i].second, ctx_.stats ? &ctx_.stats->outputReallocations : nullptr);
+			formatChatMessages(opts_, langs, shardMessages[i], ctx_, sink);
+		}
+	}
+
+	fs::path output(outputPath_);
+	std::string stem		= output.stem().string();
+	std::string extension	= output.extension().string();
+	auto shardPath = [&](std::string const& name_) { return output.parent_path() / (stem + "_" + name_ + extension); };
+
+	std::vector<OutputFile> files;
+	files.reserve(shards.size() + 2);
+
+	// Base header with includes and internal::ChatMessageBase:
+	std::string baseName = stem + "_base" + extension;
+	{
+		OutputFile base{ shardPath("base").string(), {} };
+		appendPrologue(opts_, base.contents);
+		appendEpilogue(opts_, base.contents);
+		files.push_back(std::move(base));
+	}
+
+	std::string umbrella;
+	if (opts_.usePragmaOnce)
+		umbrella += "#pragma once\n\n";
+	umbrella += "#include \"" + baseName + "\"\n";
+
+	for (auto& [name, content] : shards)
+	{
+		if (name == "base")
+			throw std::runtime_error("Could not shard chat messages - \"base\" shard name is reserved.");
+
+		OutputFile shard{ shardPath(name).string(), {} };
+		if (opts_.usePragmaOnce)
+			shard.contents += "#pragma once\n\n";
+		shard.contents += "#include \"" + baseName + "\"\n\n\n";
+		appendNamespaceBegin(opts_, shard.contents);
+		shard.contents += content;
+		appendEpilogue(opts_, shard.contents);
+		files.push_back(std::move(shard));
+
+		umbrella += "#include \"" + stem + "_" + name + extension + "\"\n";
+	}
+
+	if (opts_.nameLookup || opts_.runtimeApi || (!opts_.languages.empty() && !opts_.languageEnum.empty()))
+	{
+		umbrella += "\n\n";
+		appendNamespaceBegin(opts_, umbrella);
+		appendLanguageIndex(opts_, langs, umbrella);
+		assignMessageIds(opts_, names);
+		if (opts_.nameLookup)
+			appendNameLookup(opts_, names, umbrella);
+		if (opts_.runtimeApi)
+			appendRuntimeApi(opts_, langs, names, umbrella);
+		appendEpilogue(opts_, umbrella);
+	}
+
+	files.push_back(OutputFile{ output.string(), std::move(umbrella) });
+
+	if (ctx_.stats)
+		ctx_.stats->emit += stopwatch.lap();
+	return files;
+}
+
+////////////////////////////////////////////////
+// The header only declares the messages, texts are defined once in "<output>.cpp".
+auto emitExtern(AppOptions const& opts_, ChatProject const& project_, std::string_view outputPath_) -> std::vector<OutputFile>
+{
+	namespace fs = std::filesystem;
+
+	fs::path headerPath(outputPath_);
+	fs::path sourcePath(headerPath);
+	sourcePath.replace_extension(".cpp");
+	if (sourcePath == headerPath)
+		throw std::runtime_error("Could not generate chat messages - \"emitMode\": \"extern\" needs an output file name that doesn't end with \".cpp\".");
+
+	std::string header;
+	header.reserve(1 * 1024 * 1024);
+
+	appendIncludes(opts_, header);
+	header += "#include <cstddef>\n#include <string_view>\n\n\n";
+	appendNamespaceBegin(opts_, header);
+	header +=
+		"namespace internal {\nstruct ChatMessageBase {};\n}\n\n"
+		"struct ChatMessage\n"
+		"\t: internal::ChatMessageBase\n"
+		"{\n"
+		"\t// Indexed like \"text\" of \"emitMode\": \"classes\", languages the message has no text in are empty:\n"
+		"\tstd::string_view const*\ttext;\n"
+		"\tstd::size_t\t\t\t\ttextCount;\n"
+		"};\n\n";
+	appendLanguageIndex(opts_, project_.langs, header);
+
+	std::string source;
+	source.reserve(1 * 1024 * 1024);
+	if (!opts_.pch.empty())
+	{
+		source += "#include ";
+		source += opts_.pch;
+		source += '\n';
+	}
+	source += "#include \"" + headerPath.filename().string() + "\"\n\n#include <array>\n\n\n";
+	appendNamespaceBegin(opts_, source);
+	source += "namespace internal {\nnamespace {\n";
+
+	for (auto const& message : project_.messages)
+	{
+		header += "// \"";
+		appendCommentText(message.comment, header);
+		header += "\"\nextern ChatMessage const ";
+		header += message.uniqueName;
+		header += ";\n\n";
+
+		// Indexes of classes mode, so text arrays have the same layout:
+		std::string size = std::to_string(project_.langs.slots() ? project_.langs.slots() : message.texts.size());
+		source += "constexpr auto ";
+		source += message.uniqueName;
+		source += " = []\n{\n\tstd::array<std::string_view, ";
+		source += size;
+		source += "> result{};\n";
+
+		size_t langIndex = 0;
+		for (auto const& [langId, text] : message.texts)
+		{
+			source += "\tresult[";
+			if (opts_.languageEnum.empty() && project_.langs.slots() == 0)
+				appendNumber(langIndex, source);
+			else
+			{
+				auto lang = project_.langs.find(langId);
+				if (!lang)
+					throw std::runtime_error(fmt::format("Could not parse JSON file - chat message \"{}\" uses unknown language \"{}\".", message.uniqueName, langId));
+				source += lang->index;
+			}
+			source += "] = \"";
+			appendLiteralText(opts_, text, message.uniqueName, source, languageCodepage(opts_, langId));
+			source += "\";\n";
+			++langIndex;
+		}
+		source += "\treturn result;\n}();\n\n";
+	}
+	source += "}\n}\n\n";
+
+	for (auto const& message : project_.messages)
+		fmt::format_to(std::back_inserter(source), "ChatMessage const {0}{{ {{}}, internal::{0}.data(), internal::{0}.size() }};\n", message.uniqueName);
+
+	appendEpilogue(opts_, header);
+	appendEpilogue(opts_, source);
+
+	return { OutputFile{ headerPath.string(), std::move(header) }, OutputFile{ sourcePath.string(), std::move(source) } };
+}
+
+////////////////////////////////////////////////
+auto writeOutputFile(OutputFile const& file_) -> bool
+{
+	std::string path = file_.replaceAtomically ? file_.path + ".tmp" : file_.path;
+	{
+		std::ofstream outFile(path, std::ios::binary);
+		if (!outFile.is_open())
+			return false;
+
+		outFile.write(file_.contents.data(), static_cast<std::streamsize>(file_.contents.size()));
+		if (!outFile.flush())
+			return false;
+	}
+
+	if (file_.replaceAtomically)
+	{
+		std::error_code ec;
+		std::filesystem::rename(path, file_.path, ec);
+		return !ec;
+	}
+	return true;
+}
+
+////////////////////////////////////////////////
+auto streamChatJson(AppOptions const& opts_, std::string_view fileContents_, OutputSink& output_, GenerationContext const& ctx_) -> void
+{
+	std::string output;
+	appendPrologue(opts_, output);
+	output_.write(output);
+
+	std::string chunk;
+	chunk.reserve(64 * 1024);
+	std::vector<std::string> names;
+
+	auto langs = visitChatJson(opts_, fileContents_, true,
+		[&](LanguageTable const& langs_, json const& message_)
+		{
+			if (opts_.nameLookup || opts_.runtimeApi)
+				names.emplace_back(chatMessageName(message_));
+			chunk.clear();
+			emitChatMessage(opts_, langs_, message_, chunk, ctx_.cache, ctx_.stats);
+			output_.write(chunk);
+		}, ctx_);
+
+	if (ctx_.stats)
+		ctx_.stats->languages = langs.size();
+
+	output.clear();
+	appendLanguageIndex(opts_, langs, output);
+	assignMessageIds(opts_, names);
+	if (opts_.nameLookup)
+		appendNameLookup(opts_, names, output);
+	if (opts_.runtimeApi)
+		appendRuntimeApi(opts_, langs, names, output);
+	appendEpilogue(opts_, output);
+	output_.write(output);
+}
+
+////////////////////////////////////////////////
+auto writeOutputFilesIncremental(std::vector<OutputFile> const& files_, std::string const& manifestPath_, GenerationStats* stats_) -> bool
+{
+	// Manifest format: { "<path>": { "hash": "<hex FNV-1a>", "size": <bytes> }, ... }
+	json manifest = json::object();
+	{
+		InputFile manifestFile(manifestPath_);
+		if (manifestFile.isOpen() && !manifestFile.contents().empty())
+		{
+			auto contents = manifestFile.contents();
+			manifest = json::parse(contents.begin(), contents.end(), nullptr, false);
+			if (!manifest.is_object())
+				manifest = json::object();
+		}
+	}
+
+	json updated = json::object();
+	bool success = true;
+
+	for (auto const& file : files_)
+	{
+		std::string hash = fmt::format("{:016x}", hashBytes(file.contents));
+
+		// The existing file is always compared, so a generated file edited in place is repaired
+		// even when the manifest still describes the same bytes:
+		bool upToDate = false;
+		{
+			InputFile existing(file.path);
+			upToDate = existing.isOpen() && existing.contents() == file.contents;
+		}
+
+		if (!upToDate && !writeOutputFile(file))
+		{
+			fmt::print("Error: could not open \"{}\" file for writing.", file.path);
+			success = false;
+			continue;
+		}
+
+		if (stats_)
+		{
+			if (upToDate)
+				++stats_->filesUnchanged;
+			else
+			{
+				++stats_->filesWritten;
+				stats_->bytesWritten += file.contents.size();
+			}
+		}
+
+		updated[file.path] = { { "hash", hash }, { "size", file.contents.size() } };
+	}
+
+	if (updated != manifest && !writeOutputFile(OutputFile{ manifestPath_, updated.dump(1, '\t') + '\n' }))
+	{
+		fmt::print("Error: could not open \"{}\" file for writing.", manifestPath_);
+		success = false;
+	}
+
+	return success;
+}
+
+////////////////////////////////////////////////
+MessageCache::MessageCache(AppOptions const& opts_, std::string path_)
+	: opts(opts_), path(std::move(path_))
+{
+	// Only these options change the code of a single message:
+	optionsHash = hashBytes(opts.languageEnum, hashBytes(opts.useCompileMacro ? "1" : "0"));
+	if (opts.formatMetadata)
+		optionsHash = hashBytes("formatMetadata", optionsHash);
+	if (opts.escapeStrings)
+		optionsHash = hashBytes("escapeStrings", optionsHash);
+	if (opts.textInfo)
+		optionsHash = hashBytes("textInfo", optionsHash);
+	if (opts.typedFormat)
+		optionsHash = hashBytes("typedFormat", optionsHash);
+	for (auto const& [langId, encoding] : opts.languageEncodings)
+		optionsHash = hashBytes(encoding, hashBytes(langId, optionsHash));
+	for (auto const& langId : opts.languages)
+		optionsHash = hashBytes(langId, hashBytes("languages", optionsHash));
+	for (auto const& [langId, fallbacks] : opts.languageFallbacks)
+	{
+		optionsHash = hashBytes(langId, hashBytes("languageFallbacks", optionsHash));
+		for (auto const& fallback : fallbacks)
+			optionsHash = hashBytes(fallback, optionsHash);
+	}
+
+	file = std::make_unique<InputFile>(path);
+	if (!file->isOpen())
+		return;
+
+	auto data = file->contents();
+	size_t pos = 0;
+
+	auto read = [&](void* dst_, size_t size_)
+	{
+		if (data.size() - pos < size_)
+			return false;
+		std::memcpy(dst_, data.data() + pos, size_);
+		pos += size_;
+		return true;
+	};
+	auto readView = [&](std::string_view& dst_)
+	{
+		uint32_t size;
+		if (!read(&size, sizeof(size)) || data.size() - pos < size)
+			return false;
+		dst_ = data.substr(pos, size);
+		pos += size;
+		return true;
+	};
+
+	char magic[4];
+	uint32_t version, count;
+	uint64_t fileOptionsHash;
+	if (!read(magic, sizeof(magic)) || std::memcmp(magic, "SCTC", 4) != 0
+		|| !read(&version, sizeof(version)) || version != 1
+		|| !read(&fileOptionsHash, sizeof(fileOptionsHash)) || fileOptionsHash != optionsHash
+		|| !read(&count, sizeof(count)))
+		return;
+
+	previous.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		std::string_view name;
+		Entry entry;
+		if (!readView(name) || !read(&entry.hash, sizeof(entry.hash)) || !readView(entry.code))
+		{
+			// Truncated cache, start from scratch:
+			previous.clear();
+			return;
+		}
+		previous[name] = entry;
+	}
+}
+
+////////////////////////////////////////////////
+auto MessageCache::append(LanguageTable const& langs_, json const& value_, std::string& output_) -> bool
+{
+	if (!value_.is_object())
+		return false;
+
+	auto nameIt		= value_.find("uniqueName");
+	auto contentIt	= value_.find("content");
+	if (nameIt == value_.end() || contentIt == value_.end() || !nameIt->is_string())
+	{
+		appendChatMessage(opts, langs_, value_, output_);
+		return false;
+	}
+
+	auto const& uniqueName = nameIt->get_ref<std::string const&>();
+	uint64_t hash = contentHash(langs_, uniqueName, *contentIt);
+
+	// Declared argument types are part of the generated formatTo():
+	auto argsIt = value_.find("args");
+	if (opts.typedFormat && argsIt != value_.end())
+		hash = hashBytes(argsIt->dump(), hash);
+
+	auto it = previous.find(uniqueName);
+	if (it != previous.end() && it->second.hash == hash)
+	{
+		output_ += it->second.code;
+
+		std::lock_guard lock(currentMutex);
+		current.emplace_back(uniqueName, it->second);
+		return true;
+	}
+
+	size_t begin = output_.size();
+	appendChatMessage(opts, langs_, value_, output_);
+
+	std::lock_guard lock(currentMutex);
+	auto& code = generated.emplace_back(output_, begin);
+	current.emplace_back(uniqueName, Entry{ hash, code });
+	return false;
+}
+
+////////////////////////////////////////////////
+auto MessageCache::save() -> bool
+{
+	std::string data;
+	auto write = [&](void const* src_, size_t size_) { data.append(static_cast<char const*>(src_), size_); };
+	auto writeView = [&](std::string_view src_)
+	{
+		uint32_t size = static_cast<uint32_t>(src_.size());
+		write(&size, sizeof(size));
+		data += src_;
+	};
+
+	uint32_t version = 1;
+	uint32_t count = static_cast<uint32_t>(current.size());
+	write("SCTC", 4);
+	write(&version, sizeof(version));
+	write(&optionsHash, sizeof(optionsHash));
+	write(&count, sizeof(count));
+
+	for (auto const& [name, entry] : current)
+	{
+		writeView(name);
+		write(&entry.hash, sizeof(entry.hash));
+		writeView(entry.code);
+	}
+
+	// Cached code points into the mapped file, release it before overwriting:
+	rotate();
+
+	return writeOutputFile(OutputFile{ path, std::move(data) });
+}
+
+////////////////////////////////////////////////
+auto MessageCache::rotate() -> void
+{
+	// Code of the current run points into the mapped file and into generated,
+	// copy it to a new owner before releasing both:
+	std::deque<std::string> storage;
+	std::unordered_map<std::string_view, Entry> next;
+	next.reserve(current.size());
+
+	for (auto& [name, entry] : current)
+	{
+		auto const& ownedName = storage.emplace_back(std::move(name));
+		auto const& ownedCode = storage.emplace_back(entry.code);
+		next[ownedName] = Entry{ entry.hash, ownedCode };
+	}
+
+	previous	= std::move(next);
+	generated	= std::move(storage);
+	current.clear();
+	file.reset();
+}
+
+////////////////////////////////////////////////
+auto MessageCache::rollback() -> void
+{
+	current.clear();
+}
+
+////////////////////////////////////////////////
+auto MessageCache::contentHash(LanguageTable const& langs_, std::string const& uniqueName_, json const& content_) const -> uint64_t
+{
+	auto hashString = [](std::string_view str_, uint64_t hash_)
+	{
+		auto size = static_cast<uint64_t>(str_.size());
+		hash_ = hashBytes(std::string_view(reinterpret_cast<char const*>(&size), sizeof(size)), hash_);
+		return hashBytes(str_, hash_);
+	};
+	auto hashField = [&](json const& obj_, char const* name_, uint64_t hash_)
+	{
+		auto it = obj_.find(name_);
+		if (it != obj_.end() && it->is_string())
+			return hashString(it->get_ref<std::string const&>(), hash_);
+		return hashString({}, hash_ ^ 0xff);
+	};
+
+	uint64_t hash = hashString(uniqueName_, optionsHash);
+	for (auto const& [langId, msgContent] : content_.items())
+	{
+		auto lang = langs_.find(langId);
+		hash = hashString(langId, hash);
+		hash = hashString(lang ? std::string_view(lang->name) : std::string_view{}, hash);
+
+		// "idRegistry" indexes and the array length are part of the code:
+		if (langs_.slots())
+		{
+			hash = hashString(lang ? std::string_view(lang->index) : std::string_view{}, hash);
+			hash = hashString(std::to_string(langs_.slots()), hash);
+		}
+		hash = hashField(msgContent, "comment", hash);
+		hash = hashField(msgContent, "processed", hash);
+	}
+	return hash;
+}
+
+////////////////////////////////////////////////
+IdRegistry::IdRegistry(std::string path_)
+	: path(std::move(path_))
+{
+	InputFile file(path);
+	if (!file.isOpen())
+		return;
+
+	auto contents = file.contents();
+	json j = json::parse(contents.begin(), contents.end(), nullptr, false);
+	if (j.type() != json::value_t::object)
+		throw std::runtime_error("Could not parse id registry - \"" + path + "\" is not a JSON object.");
+
+	auto read = [&](char const* field_, Ids& ids_)
+	{
+		auto it = j.find(field_);
+		if (it == j.end())
+			return;
+		if (it->type() != json::value_t::object)
+			throw std::runtime_error(fmt::format("Could not parse id registry - \"{}\" value is not an object.", field_));
+
+		std::unordered_set<size_t> seen;
+		for (auto const& [name, value] : it->items())
+		{
+			if (value.type() != json::value_t::number_unsigned)
+				throw std::runtime_error(fmt::format("Could not parse id registry - id of \"{}\" is not an unsigned number.", name));
+
+			auto id = value.get<size_t>();
+			if (!seen.insert(id).second)
+				throw std::runtime_error(fmt::format("Could not parse id registry - \"{}\" id {} is given to several names.", field_, id));
+
+			ids_.byName.emplace(name, id);
+			ids_.next = std::max(ids_.next, id + 1);
+		}
+	};
+	read("messages", messages);
+	read("languages", languages);
+}
+
+////////////////////////////////////////////////
+auto IdRegistry::messageId(std::string_view uniqueName_) -> size_t
+{
+	std::lock_guard lock(mutex);
+	return assign(messages, uniqueName_);
+}
+
+////////////////////////////////////////////////
+auto IdRegistry::languageId(std::string_view langId_) -> size_t
+{
+	std::lock_guard lock(mutex);
+	return assign(languages, langId_);
+}
+
+////////////////////////////////////////////////
+auto IdRegistry::messageCount() -> size_t
+{
+	std::lock_guard lock(mutex);
+	return messages.next;
+}
+
+////////////////////////////////////////////////
+auto IdRegistry::languageCount() -> size_t
+{
+	std::lock_guard lock(mutex);
+	return languages.next;
+}
+
+////////////////////////////////////////////////
+auto IdRegistry::assign(Ids& ids_, std::string_view name_) -> size_t
+{
+	auto it = ids_.byName.find(name_);
+	if (it != ids_.byName.end())
+		return it->second;
+
+	changed = true;
+	ids_.byName.emplace(std::string(name_), ids_.next);
+	return ids_.next++;
+}
+
+////////////////////////////////////////////////
+auto IdRegistry::save() -> bool
+{
+	std::lock_guard lock(mutex);
+	if (!changed)
+		return true;
+
+	json j = json::object();
+	j["messages"]	= json::object();
+	j["languages"]	= json::object();
+	for (auto const& [name, id] : messages.byName)
+		j["messages"][name] = id;
+	for (auto const& [name, id] : languages.byName)
+		j["languages"][name] = id;
+
+	if (!writeOutputFile(OutputFile{ path, j.dump(1, '\t') + '\n', true }))
+		return false;
+
+	changed = false;
+	return true;
+}
+
+////////////////////////////////////////////////
+MessageValidator::MessageValidator(AppOptions const& opts_)
+	: opts(opts_)
+{
+}
+
+////////////////////////////////////////////////
+// JSON pointer of a path below base_, e.g. "/chatMessages/3/content/pl":
+static auto jsonPath(std::string base_, std::string_view key_) -> std::string
+{
+	base_ += '/';
+	for (char ch : key_)
+	{
+		if (ch == '~')
+			base_ += "~0";
+		else if (ch == '/')
+			base_ += "~1";
+		else
+			base_ += ch;
+	}
+	return base_;
+}
+
+////////////////////////////////////////////////
+static auto isIdentifier(std::string_view name_) -> bool
+{
+	if (name_.empty() || std::isdigit(static_cast<unsigned char>(name_.front())))
+		return false;
+	return std::all_of(name_.begin(), name_.end(), [](char ch_) { return ch_ == '_' || std::isalnum(static_cast<unsigned char>(ch_)); });
+}
+
+////////////////////////////////////////////////
+auto MessageValidator::checkLanguages(json const& languages_) -> void
+{
+	seenLanguages = true;
+	for (size_t i = 0; i < languages_.size(); ++i)
+	{
+		auto const& language = languages_[i];
+		auto path = jsonPath("/languages", std::to_string(i));
+		if (!language.is_object())
+		{
+			issues.push_back(Issue{ 0, path, "is not an object" });
+			continue;
+		}
+
+		auto idIt	= language.find("id");
+		auto nameIt	= language.find("name");
+		if (idIt == language.end() || !idIt->is_string())
+			issues.push_back(Issue{ 0, jsonPath(path, "id"), "is missing or not a string" });
+		else
+			languageIds.insert(idIt->get_ref<std::string const&>());
+
+		if (nameIt == language.end() || !nameIt->is_string())
+			issues.push_back(Issue{ 0, jsonPath(path, "name"), "is missing or not a string" });
+		else if (!opts.languageEnum.empty() && !isIdentifier(nameIt->get_ref<std::string const&>()))
+			issues.push_back(Issue{ 0, jsonPath(path, "name"), fmt::format("\"{}\" is not a valid enumerator of \"{}\"", nameIt->get_ref<std::string const&>(), opts.languageEnum) });
+	}
+}
+
+////////////////////////////////////////////////
+auto MessageValidator::checkMessage(json const& message_, size_t index_) -> bool
+{
+	size_t issueCount = issues.size();
+	checkContent(message_, index_, issues, languageUses);
+	checkName(message_, index_);
+	return issues.size() == issueCount;
+}
+
+////////////////////////////////////////////////
+auto MessageValidator::checkMessages(json const& messages_, size_t jobs_) -> void
+{
+	// Small projects are not worth starting threads:
+	constexpr size_t MinMessagesPerJob = 256;
+	size_t jobs = std::max<size_t>(std::min(jobs_, messages_.size() / MinMessagesPerJob + 1), 1);
+
+	size_t chunkCount	= jobs * 8;
+	size_t chunkSize	= (messages_.size() + chunkCount - 1) / chunkCount;
+
+	std::vector< std::vector<Issue> >	chunkIssues(chunkCount);
+	std::vector<LanguageUses>			chunkUses(chunkCount);
+	std::vector<std::exception_ptr>		errors(chunkCount);
+	std::atomic<size_t>					nextChunk{ 0 };
+
+	auto worker = [&]
+	{
+		for (size_t chunk; (chunk = nextChunk++) < chunkCount;)
+		{
+			size_t begin	= std::min(chunk * chunkSize, messages_.size());
+			size_t end		= std::min(begin + chunkSize, messages_.size());
+			try
+			{
+				for (size_t i = begin; i < end; ++i)
+					checkContent(messages_[i], i, chunkIssues[chunk], chunkUses[chunk]);
+			}
+			catch (...)
+			{
+				errors[chunk] = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(jobs - 1);
+	for (size_t i = 1; i < jobs; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto const& error : errors)
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		std::move(chunkIssues[chunk].begin(), chunkIssues[chunk].end(), std::back_inserter(issues));
+		for (auto const& [langId, index] : chunkUses[chunk])
+			languageUses.try_emplace(langId, index);
+	}
+
+	for (size_t i = 0; i < messages_.size(); ++i)
+		checkName(messages_[i], i);
+}
+
+////////////////////////////////////////////////
+auto MessageValidator::checkContent(json const& message_, size_t index_, std::vector<Issue>& issues_, LanguageUses& uses_) const -> void
+{
+	// SAMP clients show at most this many bytes of a chat message:
+	constexpr size_t MaxChatLength = 144;
+
+	auto path = jsonPath("/chatMessages", std::to_string(index_));
+	auto issue = [&](std::string path_, std::string text_)
+	{
+		issues_.push_back(Issue{ index_ + 1, std::move(path_), std::move(text_) });
+	};
+
+	if (!message_.is_object())
+		return issue(path, "is not an object");
+
+	auto nameIt = message_.find("uniqueName");
+	std::string uniqueName;
+	if (nameIt == message_.end() || !nameIt->is_string())
+		issue(jsonPath(path, "uniqueName"), "is missing or not a string");
+	else
+	{
+		uniqueName = nameIt->get_ref<std::string const&>();
+		if (!isIdentifier(uniqueName))
+			issue(jsonPath(path, "uniqueName"), fmt::format("\"{}\" is not a valid C++ identifier", uniqueName));
+	}
+
+	auto contentIt = message_.find("content");
+	if (contentIt == message_.end() || !contentIt->is_object())
+		return issue(jsonPath(path, "content"), "is missing or not an object");
+
+	size_t argCount = 0;
+	std::string_view firstLangId;
+	for (auto const& [langId, msgContent] : contentIt->items())
+	{
+		auto langPath = jsonPath(jsonPath(path, "content"), langId);
+		uses_.try_emplace(langId, index_);
+
+		if (!msgContent.is_object())
+		{
+			issue(langPath, "is not an object");
+			continue;
+		}
+
+		auto commentIt = msgContent.find("comment");
+		if (commentIt == msgContent.end() || !commentIt->is_string())
+			issue(jsonPath(langPath, "comment"), "is missing or not a string");
+
+		auto processedIt = msgContent.find("processed");
+		if (processedIt == msgContent.end() || !processedIt->is_string())
+		{
+			issue(jsonPath(langPath, "processed"), "is missing or not a string");
+			continue;
+		}
+
+		try
+		{
+			auto format = parseFormatString(processedIt->get_ref<std::string const&>(), uniqueName, langId);
+			if (firstLangId.empty())
+			{
+				argCount	= format.argCount;
+				firstLangId	= langId;
+			}
+			else if (format.argCount != argCount)
+				issue(jsonPath(langPath, "processed"), fmt::format("has {} format arguments, but {} in \"{}\"", format.argCount, argCount, firstLangId));
+
+			size_t length = 0;
+			auto codepage = languageCodepage(opts, langId);
+			for (auto const& segment : format.segments)
+				length += literalBytes(opts, segment.literal, codepage, uniqueName, langId).size();
+			if (length > MaxChatLength)
+				issue(jsonPath(langPath, "processed"), fmt::format("is {} bytes long without its arguments, a chat line holds {}", length, MaxChatLength));
+		}
+		catch (std::runtime_error const& ex_)
+		{
+			std::string_view what = ex_.what();
+			constexpr std::string_view Prefix = "Could not parse JSON file - ";
+			if (what.substr(0, Prefix.size()) == Prefix)
+				what.remove_prefix(Prefix.size());
+			issue(jsonPath(langPath, "processed"), std::string(what));
+		}
+	}
+}
+
+////////////////////////////////////////////////
+auto MessageValidator::checkName(json const& message_, size_t index_) -> void
+{
+	auto name = chatMessageName(message_);
+	if (name.empty())
+		return;
+
+	auto [it, inserted] = names.try_emplace(std::string(name), index_);
+	if (!inserted)
+	{
+		issues.push_back(Issue{ index_ + 1, jsonPath(jsonPath("/chatMessages", std::to_string(index_)), "uniqueName"),
+			fmt::format("\"{}\" is already used by /chatMessages/{}", name, it->second) });
+	}
+}
+
+////////////////////////////////////////////////
+auto MessageValidator::report() const -> void
+{
+	std::vector<Issue const*> sorted;
+	sorted.reserve(issues.size());
+	for (auto const& issue : issues)
+		sorted.push_back(&issue);
+
+	// Languages of the messages are known only once the "languages" array was read:
+	std::vector<Issue> unknown;
+	if (seenLanguages)
+	{
+		for (auto const& [langId, index] : languageUses)
+		{
+			if (languageIds.count(langId) == 0)
+				unknown.push_back(Issue{ index + 1, jsonPath(jsonPath(jsonPath("/chatMessages", std::to_string(index)), "content"), langId), "language is not defined in /languages" });
+		}
+	}
+	for (auto const& issue : unknown)
+		sorted.push_back(&issue);
+
+	if (sorted.empty())
+		return;
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](Issue const* lhs_, Issue const* rhs_) { return lhs_->order < rhs_->order; });
+
+	std::string text = fmt::format("Could not validate JSON file - {} problem{}:", sorted.size(), sorted.size() == 1 ? "" : "s");
+	for (auto issue : sorted)
+		fmt::format_to(std::back_inserter(text), "\n\t{}: {}", issue->path, issue->text);
+	throw std::runtime_error(text);
+}
+
+////////////////////////////////////////////////
+// 64-bit FNV-1a, used to detect changes of generated code.
+auto hashBytes(std::string_view bytes_, uint64_t hash_) -> uint64_t
+{
+	for (unsigned char ch : bytes_)
+	{
+		hash_ ^= ch;
+		hash_ *= 1099511628211ull;
+	}
+	return hash_;
+}
+
+////////////////////////////////////////////////
+auto printStats(GenerationStats const& stats_) -> void
+{
+	double const KiB = 1024.0;
+	double total = stats_.readOptions + stats_.readInput + stats_.parse + stats_.emit + stats_.write;
+
+	fmt::print("Phases:\n");
+	fmt::print("  {:<20}{:>10.2f} ms\n", "readAppOptions",	stats_.readOptions * 1000.0);
+	fmt::print("  {:<20}{:>10.2f} ms\n", "read input",		stats_.readInput * 1000.0);
+	fmt::print("  {:<20}{:>10.2f} ms\n", "json::parse",		stats_.parse * 1000.0);
+	fmt::print("  {:<20}{:>10.2f} ms\n", "emit messages",	stats_.emit * 1000.0);
+	fmt::print("  {:<20}{:>10.2f} ms\n", "write output",		stats_.write * 1000.0);
+	fmt::print("  {:<20}{:>10.2f} ms\n", "total",			total * 1000.0);
+	fmt::print("Bytes read:         {:.1f} KiB\n", stats_.bytesRead / KiB);
+	fmt::print("Bytes generated:    {:.1f} KiB\n", stats_.bytesGenerated / KiB);
+	fmt::print("Bytes written:      {:.1f} KiB ({} files written, {} unchanged)\n", stats_.bytesWritten / KiB, stats_.filesWritten, stats_.filesUnchanged);
+	fmt::print("Messages:           {} ({} reused from cache, {} unused skipped)\n", stats_.messages, stats_.cachedMessages, stats_.unusedMessages);
+	fmt::print("Languages:          {}\n", stats_.languages);
+	fmt::print("Largest message:    \"{}\" ({} bytes)\n", stats_.largestMessage, stats_.largestMessageSize);
+	fmt::print("Reallocations:      {} message buffer, {} output\n", stats_.contentReallocations, stats_.outputReallocations);
+	fmt::print("Peak RSS:           {:.1f} KiB\n", peakMemoryUsage() / KiB);
+}
+
+////////////////////////////////////////////////
+auto statsToJson(GenerationStats const& stats_) -> json
+{
+	return {
+		{ "phases", {
+			{ "readAppOptions",	stats_.readOptions },
+			{ "readInput",		stats_.readInput },
+			{ "parse",			stats_.parse },
+			{ "emit",			stats_.emit },
+			{ "write",			stats_.write }
+		} },
+		{ "bytesRead",				stats_.bytesRead },
+		{ "bytesGenerated",			stats_.bytesGenerated },
+		{ "bytesWritten",			stats_.bytesWritten },
+		{ "filesWritten",			stats_.filesWritten },
+		{ "filesUnchanged",			stats_.filesUnchanged },
+		{ "messages",				stats_.messages },
+		{ "cachedMessages",			stats_.cachedMessages },
+		{ "unusedMessages",			stats_.unusedMessages },
+		{ "languages",				stats_.languages },
+		{ "largestMessage",			{ { "uniqueName", stats_.largestMessage }, { "bytes", stats_.largestMessageSize } } },
+		{ "contentReallocations",	stats_.contentReallocations },
+		{ "outputReallocations",	stats_.outputReallocations },
+		{ "peakMemory",				peakMemoryUsage() }
+	};
+}
+
+////////////////////////////////////////////////
+// Peak resident set size of this process in bytes.
+auto peakMemoryUsage() -> size_t
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss);
+	#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+	#endif
+#endif
+}
+
+////////////////////////////////////////////////
+// UX Designer project with random texts, identical for the same seed.
+auto generateSyntheticProject(CliOptions const& cli_, uint32_t seed_) -> std::string
+{
+	std::mt19937 random(seed_);
+	std::uniform_int_distribution<size_t> lengthDist(cli_.benchMinLength, cli_.benchMaxLength);
+	std::uniform_int_distribution<int> charDist(0, 99);
+
+	constexpr std::string_view Letters = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789.,!";
+
+	std::string project;
+	project.reserve(cli_.benchMessages * cli_.benchLanguages * (cli_.benchMaxLength + 64));
+	project += "{\"languages\":[";
+	for (size_t lang = 0; lang < cli_.benchLanguages; ++lang)
+		fmt::format_to(std::back_inserter(project), "{}{{\"id\":\"l{}\",\"name\":\"Lang{}\"}}", lang ? "," : "", lang, lang);
+
+	project += "],\"chatMessages\":[";
+	for (size_t msg = 0; msg < cli_.benchMessages; ++msg)
+	{
+		fmt::format_to(std::back_inserter(project), "{}{{\"uniqueName\":\"Bench_{}\",\"content\":{{", msg ? "," : "", msg);
+		for (size_t lang = 0; lang < cli_.benchLanguages; ++lang)
+		{
+			fmt::format_to(std::back_inserter(project), "{}\"l{}\":{{\"comment\":\"Message {} in Lang{}\",\"processed\":\"", lang ? "," : "", lang, msg, lang);
+
+			// Mostly letters, with some color tags and format placeholders:
+			size_t length = lengthDist(random);
+			for (size_t written = 0; written < length;)
+			{
+				int roll = charDist(random);
+				if (roll < 2)
+				{
+					project += "{FF0000}";
+					written += 8;
+				}
+				else if (roll < 4)
+				{
+					project += "{}";
+					written += 2;
+				}
+				else
+				{
+					project += Letters[static_cast<size_t>(roll) % Letters.size()];
+					written += 1;
+				}
+			}
+			project += "\"}";
+		}
+		project += "}}";
+	}
+	project += "]}";
+	return project;
+}
+
+////////////////////////////////////////////////
+auto runBenchmark(AppOptions const& opts_, CliOptions const& cli_) -> bool
+{
+	namespace fs = std::filesystem;
+
+	constexpr uint32_t Seed = 1337;
+	fmt::print("Generating synthetic project: {} messages, {} languages, {}-{} characters per text (seed {})\n",
+		cli_.benchMessages, cli_.benchLanguages, cli_.benchMinLength, cli_.benchMaxLength, Seed);
+
+	auto inputPath	= (fs::temp_directory_path() / fmt::format("samp-ct-bench-{}.json", Seed)).string();
+	auto outputPath	= (fs::temp_directory_path() / fmt::format("samp-ct-bench-{}.hpp", Seed)).string();
+	if (!writeOutputFile(OutputFile{ inputPath, generateSyntheticProject(cli_, Seed) }))
+	{
+		fmt::print("Error: could not open \"{}\" file for writing.", inputPath);
+		return false;
+	}
+
+	struct Phase
+	{
+		char const*	name;
+		double		seconds = 0;
+	};
+	std::vector<Phase> best = { { "read" }, { "json::parse" }, { "resolve languages" }, { "format messages" }, { "write output" } };
+
+	size_t inputSize = 0, outputSize = 0;
+	for (size_t run = 0; run < cli_.benchRuns; ++run)
+	{
+		std::vector<double> times;
+		Stopwatch stopwatch;
+
+		InputFile inFile(inputPath);
+		auto contents = inFile.contents();
+
+		// Touch every page, so mapped input is actually read:
+		volatile char sink = 0;
+		for (size_t i = 0; i < contents.size(); i += 4096)
+			sink = sink + contents[i];
+		inputSize = contents.size();
+		times.push_back(stopwatch.lap());
+
+		json j = json::parse(contents.begin(), contents.end());
+		times.push_back(stopwatch.lap());
+
+		std::vector<json const*> messages;
+		auto langs = visitChatDocument(opts_, j,
+			[&](LanguageTable const&, json const& message_)
+			{
+				messages.push_back(&message_);
+			});
+		times.push_back(stopwatch.lap());
+
+		std::string output;
+		output.reserve(1 * 1024 * 1024);
+		appendPrologue(opts_, output);
+		StringSink outputSink(output);
+		formatChatMessages(opts_, langs, messages, GenerationContext{ nullptr, nullptr, cli_.jobs }, outputSink);
+		appendEpilogue(opts_, output);
+		times.push_back(stopwatch.lap());
+
+		writeOutputFile(OutputFile{ outputPath, output });
+		outputSize = output.size();
+		times.push_back(stopwatch.lap());
+
+		for (size_t i = 0; i < best.size(); ++i)
+		{
+			if (run == 0 || times[i] < best[i].seconds)
+				best[i].seconds = times[i];
+		}
+	}
+
+	double total = 0;
+	for (auto const& phase : best)
+		total += phase.seconds;
+
+	double const MiB = 1024.0 * 1024.0;
+	fmt::print("Fastest of {} runs ({} jobs):\n", cli_.benchRuns, cli_.jobs);
+	for (auto const& phase : best)
+		fmt::print("  {:<20}{:>10.2f} ms\n", phase.name, phase.seconds * 1000.0);
+	fmt::print("  {:<20}{:>10.2f} ms\n", "total", total * 1000.0);
+	fmt::print("Input:      {:.2f} MiB, {:.2f} MiB/s\n", inputSize / MiB, inputSize / MiB / total);
+	fmt::print("Output:     {:.2f} MiB, {:.2f} MiB/s\n", outputSize / MiB, outputSize / MiB / total);
+	fmt::print("Messages:   {:.0f} messages/s\n", cli_.benchMessages / total);
+	fmt::print("Peak RSS:   {:.2f} MiB\n", peakMemoryUsage() / MiB);
+
+	double messagesPerSecond	= cli_.benchMessages / total;
+	size_t peakMemory			= peakMemoryUsage();
+
+	bool passed;
+	{
+		InputFile inFile(inputPath);
+		passed = checkOutputEquivalence(opts_, inFile.contents(), std::max<size_t>(cli_.jobs, 4));
+	}
+
+	if (!cli_.benchBaseline.empty())
+	{
+		std::string baselinePath(cli_.benchBaseline);
+		InputFile baselineFile(baselinePath);
+		if (!baselineFile.isOpen())
+		{
+			json baseline = { { "messagesPerSecond", messagesPerSecond }, { "peakMemory", peakMemory } };
+			if (writeOutputFile(OutputFile{ baselinePath, baseline.dump(1, '\t') + '\n' }))
+				fmt::print("Baseline:   written to \"{}\"\n", baselinePath);
+			else
+			{
+				fmt::print("Error: could not open \"{}\" file for writing.\n", baselinePath);
+				passed = false;
+			}
+		}
+		else
+		{
+			auto contents = baselineFile.contents();
+			json baseline = json::parse(contents.begin(), contents.end(), nullptr, false);
+			if (!baseline.is_object() || !baseline.contains("messagesPerSecond") || !baseline.contains("peakMemory")
+				|| !baseline["messagesPerSecond"].is_number() || !baseline["peakMemory"].is_number())
+				throw std::runtime_error("Could not parse bench baseline - \"" + baselinePath + "\" has no \"messagesPerSecond\" and \"peakMemory\" numbers.");
+
+			double tolerance		= cli_.benchTolerance / 100.0;
+			double baselineRate		= baseline["messagesPerSecond"].get<double>();
+			double baselineMemory	= baseline["peakMemory"].get<double>();
+
+			bool rateOk		= messagesPerSecond >= baselineRate * (1.0 - tolerance);
+			bool memoryOk	= peakMemory <= baselineMemory * (1.0 + tolerance);
+			fmt::print("Baseline:   {:.0f} messages/s ({:+.1f}%) {}, {:.2f} MiB peak RSS ({:+.1f}%) {}\n",
+				baselineRate, (messagesPerSecond / baselineRate - 1.0) * 100.0, rateOk ? "ok" : "REGRESSED",
+				baselineMemory / MiB, (peakMemory / baselineMemory - 1.0) * 100.0, memoryOk ? "ok" : "REGRESSED");
+			passed = passed && rateOk && memoryOk;
+		}
+	}
+
+	std::error_code ec;
+	fs::remove(inputPath, ec);
+	fs::remove(outputPath, ec);
+	return passed;
+}
+
+////////////////////////////////////////////////
+// Generates the project with the single-threaded parser, which is the reference,
+// and compares "--jobs", "--stream" and a run that reuses every message from MessageCache with it.
+// Streaming is checked again with "chatMessages" before "languages", with and without "idRegistry" slots.
+auto checkOutputEquivalence(AppOptions const& opts_, std::string_view fileContents_, size_t jobs_) -> bool
+{
+	namespace fs = std::filesystem;
+
+	auto stream = [](AppOptions const& opts_, std::string_view fileContents_)
+	{
+		std::string output;
+		StringSink sink(output);
+		streamChatJson(opts_, fileContents_, sink);
+		return output;
+	};
+
+	// Object keys are dumped in sorted order, so "chatMessages" comes first:
+	json project = json::parse(fileContents_.begin(), fileContents_.end());
+	auto reordered = project.dump();
+
+	auto reference = parseChatJson(opts_, fileContents_);
+
+	std::vector< std::tuple<char const*, std::string, std::string const*> > outputs;
+	outputs.emplace_back("parallel", parseChatJson(opts_, fileContents_, GenerationContext{ nullptr, nullptr, jobs_ }), &reference);
+	outputs.emplace_back("streaming", stream(opts_, fileContents_), &reference);
+	outputs.emplace_back("reordered streaming", stream(opts_, reordered), &reference);
+	{
+		// A cache that doesn't exist yet, filled by the first run and reused by the second:
+		auto cachePath = (fs::temp_directory_path() / "samp-ct-bench-equivalence.cache").string();
+		std::error_code ec;
+		fs::remove(cachePath, ec);
+
+		MessageCache cache(opts_, cachePath);
+		parseChatJson(opts_, fileContents_, GenerationContext{ &cache, nullptr, 1 });
+		cache.rotate();
+		outputs.emplace_back("cached", parseChatJson(opts_, fileContents_, GenerationContext{ &cache, nullptr, 1 }), &reference);
+	}
+
+	std::string registryReference;
+	if (!opts_.idRegistry)
+	{
+		// A registry that is never saved, with language ids in reverse order and an unused slot,
+		// so text arrays differ from positional ones:
+		auto registryPath = (fs::temp_directory_path() / "samp-ct-bench-equivalence.ids").string();
+		std::error_code ec;
+		fs::remove(registryPath, ec);
+
+		AppOptions registryOpts = opts_;
+		registryOpts.idRegistry = std::make_shared<IdRegistry>(registryPath);
+		registryOpts.idRegistry->languageId("samp-ct-unused");
+
+		auto const& langs = project["languages"];
+		for (auto it = langs.rbegin(); it != langs.rend(); ++it)
+			registryOpts.idRegistry->languageId((*it)["id"].get_ref<std::string const&>());
+
+		registryReference = parseChatJson(registryOpts, fileContents_);
+		outputs.emplace_back("reordered streaming with \"idRegistry\"", stream(registryOpts, reordered), &registryReference);
+	}
+
+	bool identical = true;
+	for (auto const& [name, output, expected] : outputs)
+	{
+		if (output == *expected)
+			continue;
+
+		auto mismatch = std::mismatch(output.begin(), output.end(), expected->begin(), expected->end());
+		fmt::print("Output:     {} output differs from the single-threaded one at byte {}\n", name, mismatch.first - output.begin());
+		identical = false;
+	}
+	if (identical)
+		fmt::print("Output:     parallel, streaming and cached output identical\n");
+	return identical;
+}
+
+////////////////////////////////////////////////
+// Estimates are counted in the generated code of every message, so they follow the options:
+// constexpr evaluations are the constexpr initializers and the assignments of their lambdas.
+auto runCompileCostReport(AppOptions const& opts_, CliOptions const& cli_) -> void
+{
+	struct Cost
+	{
+		size_t messages				= 0;
+		size_t languages			= 0;
+		size_t arraySize			= 0;
+		size_t literalBytes			= 0;
+		size_t constexprEvaluations	= 0;
+		size_t fmtCompile			= 0;
+		size_t codeBytes			= 0;
+
+		auto add(Cost const& other_) -> void
+		{
+			messages				+= other_.messages;
+			languages				+= other_.languages;
+			arraySize				+= other_.arraySize;
+			literalBytes			+= other_.literalBytes;
+			constexprEvaluations	+= other_.constexprEvaluations;
+			fmtCompile				+= other_.fmtCompile;
+			codeBytes				+= other_.codeBytes;
+		}
+
+		auto toJson() const -> json
+		{
+			return json{
+				{ "languages",				languages },
+				{ "arraySize",				arraySize },
+				{ "literalBytes",			literalBytes },
+				{ "constexprEvaluations",	constexprEvaluations },
+				{ "fmtCompile",				fmtCompile },
+				{ "codeBytes",				codeBytes }
+			};
+		}
+	};
+
+	auto count = [](std::string_view code_, std::string_view what_)
+	{
+		size_t result = 0;
+		for (size_t pos = code_.find(what_); pos != std::string_view::npos; pos = code_.find(what_, pos + what_.size()))
+			++result;
+		return result;
+	};
+
+	InputFile inFile(cli_.files[1]);
+	if (!inFile.isOpen())
+	{
+		fmt::print("Error: could not open \"{}\" input file for reading.", cli_.files[1]);
+		return;
+	}
+
+	// The other emission modes are the cheaper alternatives, so "classes" code is measured:
+	AppOptions opts = opts_;
+	opts.emitMode = EmitMode::Classes;
+
+	auto contents = inFile.contents();
+	json j = json::parse(contents.begin(), contents.end());
+
+	std::vector<json const*> messages;
+	auto langs = visitChatDocument(opts, j,
+		[&](LanguageTable const&, json const& message_)
+		{
+			messages.push_back(&message_);
+		});
+
+	std::vector< std::pair<std::string, Cost> > costs;
+	std::vector< std::pair<std::string, Cost> > shards;
+	std::unordered_map<std::string, size_t> shardIndices;
+	Cost total;
+
+	json report = json::object();
+	report["messages"] = json::array();
+
+	std::string code;
+	for (size_t i = 0; i < messages.size(); ++i)
+	{
+		auto const& message = *messages[i];
+		auto name = chatMessageName(message);
+		if (name.empty())
+			continue;
+
+		code.clear();
+		appendChatMessage(opts, langs, message, code);
+
+		auto const& content = message.at("content");
+		Cost cost;
+		cost.messages				= 1;
+		cost.languages				= content.size();
+		cost.arraySize				= langs.slots() ? langs.slots() : content.size();
+		cost.constexprEvaluations	= count(code, "static constexpr") + count(code, "result[");
+		cost.fmtCompile				= count(code, "FMT_COMPILE(");
+		cost.codeBytes				= code.size();
+		for (auto const& [langId, msgContent] : content.items())
+			cost.literalBytes += literalBytes(opts, messageText(msgContent, "processed", name, langId), languageCodepage(opts, langId), name, langId).size();
+
+		auto shard = shardKey(opts, message, i);
+		auto [it, inserted] = shardIndices.try_emplace(shard, shards.size());
+		if (inserted)
+			shards.emplace_back(shard, Cost{});
+		shards[it->second].second.add(cost);
+		total.add(cost);
+
+		auto entry = cost.toJson();
+		entry["uniqueName"]	= name;
+		entry["shard"]		= shard;
+		report["messages"].push_back(std::move(entry));
+		costs.emplace_back(std::string(name), cost);
+	}
+
+	report["shards"] = json::array();
+	for (auto const& [shard, cost] : shards)
+	{
+		auto entry = cost.toJson();
+		entry["name"]		= shard;
+		entry["messages"]	= cost.messages;
+		report["shards"].push_back(std::move(entry));
+	}
+	report["total"] = total.toJson();
+	report["total"]["messages"] = total.messages;
+
+	if (!writeOutputFile(OutputFile{ std::string(cli_.compileCostReport), report.dump(1, '\t') + '\n' }))
+	{
+		fmt::print("Error: could not open \"{}\" file for writing.", cli_.compileCostReport);
+		return;
+	}
+
+	fmt::print("Compile cost of {} messages: {} constexpr evaluations, {} FMT_COMPILE instantiations, {} literal bytes, {} bytes of code\n",
+		total.messages, total.constexprEvaluations, total.fmtCompile, total.literalBytes, total.codeBytes);
+
+	if (opts.shardBy != ShardMode::None)
+	{
+		for (auto const& [shard, cost] : shards)
+			fmt::print("  shard {:<24}{:>8} messages{:>10} evaluations{:>8} FMT_COMPILE{:>10} literal bytes\n",
+				shard, cost.messages, cost.constexprEvaluations, cost.fmtCompile, cost.literalBytes);
+	}
+
+	// FMT_COMPILE instantiations cost the most, then constant evaluation:
+	std::stable_sort(costs.begin(), costs.end(), [](auto const& lhs_, auto const& rhs_)
+		{
+			return std::tie(lhs_.second.fmtCompile, lhs_.second.constexprEvaluations, lhs_.second.literalBytes)
+				> std::tie(rhs_.second.fmtCompile, rhs_.second.constexprEvaluations, rhs_.second.literalBytes);
+		});
+
+	constexpr size_t TopCount = 10;
+	fmt::print("Most expensive messages:\n");
+	for (size_t i = 0; i < std::min(costs.size(), TopCount); ++i)
+	{
+		auto const& [name, cost] = costs[i];
+		fmt::print("  {:<32}{:>8} evaluations{:>8} FMT_COMPILE{:>10} literal bytes\n",
+			name, cost.constexprEvaluations, cost.fmtCompile, cost.literalBytes);
+	}
+}
+
+////////////////////////////////////////////////
+auto readArgs(int argc, char* argv[]) -> std::vector< std::string_view >
+{
+	auto args = std::vector< std::string_view >{};
+	args.reserve(argc);
+	for(int i = 0; i < argc; ++i)
+		args.push_back(argv[i]);
+
+	return args;
+}
+
+////////////////////////////////////////////////
+auto readCliOptions(CliOptions& cli_, std::vector< std::string_view > const& args_) -> void
+{
+	for (size_t i = 1; i < args_.size(); ++i)
+	{
+		auto const& arg = args_[i];
+		if (arg.substr(0, 2) != "--")
+		{
+			cli_.files.push_back(arg);
+			continue;
+		}
+
+		if (arg == "--stream")
+			cli_.streaming = true;
+		else if (arg == "--incremental")
+			cli_.incremental = true;
+		else if (arg == "--bench")
+			cli_.bench = true;
+		else if (arg == "--stats")
+			cli_.stats = true;
+		else if (arg == "--watch")
+			cli_.watch = true;
+		else
+		{
+			if (i + 1 == args_.size())
+				throw std::runtime_error(fmt::format("Unknown command line option \"{}\" or its value is missing.", arg));
+
+			auto value = std::string(args_[++i]);
+			if (arg == "--jobs")
+			{
+				cli_.jobs = std::stoul(value);
+				if (cli_.jobs == 0)
+					cli_.jobs = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			else if (arg == "--stats-json")
+				cli_.statsJson = args_[i];
+			else if (arg == "--batch")
+				cli_.batch = args_[i];
+			else if (arg == "--report-compile-cost")
+				cli_.compileCostReport = args_[i];
+			else if (arg == "--languages")
+			{
+				cli_.languages.clear();
+				for (size_t begin = 0; begin <= value.size();)
+				{
+					size_t end = std::min(value.find(',', begin), value.size());
+					if (end > begin)
+						cli_.languages.push_back(value.substr(begin, end - begin));
+					begin = end + 1;
+				}
+			}
+			else if (arg == "--bench-messages")
+				cli_.benchMessages = std::stoul(value);
+			else if (arg == "--bench-languages")
+				cli_.benchLanguages = std::max<size_t>(std::stoul(value), 1);
+			else if (arg == "--bench-runs")
+				cli_.benchRuns = std::max<size_t>(std::stoul(value), 1);
+			else if (arg == "--bench-baseline")
+				cli_.benchBaseline = args_[i];
+			else if (arg == "--bench-tolerance")
+				cli_.benchTolerance = std::max(std::stod(value), 0.0);
+			else if (arg == "--bench-length")
+			{
+				auto sep = value.find(':');
+				cli_.benchMinLength = std::stoul(value.substr(0, sep));
+				cli_.benchMaxLength = (sep == std::string::npos) ? cli_.benchMinLength : std::stoul(value.substr(sep + 1));
+				if (cli_.benchMaxLength < cli_.benchMinLength)
+					std::swap(cli_.benchMinLength, cli_.benchMaxLength);
+			}
+			else
+				throw std::runtime_error(fmt::format("Unknown command line option \"{}\".", arg));
+		}
+	}
+}
+
+////////////////////////////////////////////////
+auto readAppOptions(AppOptions& opts_, std::string_view fileContents_) -> void
+{
+	json j = json::parse(fileContents_.begin(), fileContents_.end());
+
+	if (j.type() != json::value_t::object)
+		throw std::runtime_error("Could not parse options file - value is not an object.");
+
+	#define READ_OPTION(CppName, CppType, JsonName, JsonType) \
+		if (j.contains(JsonName)) \
+		{ \
+			auto const& val = j[JsonName]; \
+			if (val.type() != json::value_t::JsonType) \
+				throw std::runtime_error("Could not parse options file - \"" JsonName "\" value is not a "#JsonType"."); \
+			opts_.CppName = j[JsonName].get<CppType>(); \
+		}
+
+
+	READ_OPTION(useCompileMacro,	bool, "useCompileMacro",		boolean);
+	READ_OPTION(usePragmaOnce,		bool, "usePragmaOnce",			boolean);
+	READ_OPTION(deduplicateStrings,	bool, "deduplicateStrings",		boolean);
+	READ_OPTION(shareSuffixes,		bool, "shareSuffixes",			boolean);
+	READ_OPTION(nameLookup,			bool, "nameLookup",				boolean);
+	READ_OPTION(runtimeApi,			bool, "runtimeApi",				boolean);
+	READ_OPTION(formatMetadata,		bool, "formatMetadata",			boolean);
+	READ_OPTION(validate,			bool, "validate",				boolean);
+	READ_OPTION(escapeStrings,		bool, "escapeStrings",			boolean);
+	READ_OPTION(textInfo,			bool, "textInfo",				boolean);
+	READ_OPTION(typedFormat,		bool, "typedFormat",			boolean);
+
+	READ_OPTION(languageEnum,		std::string, "languageEnum",	string);
+	READ_OPTION(pch,				std::string, "pch",				string);
+	READ_OPTION(ns,					std::string, "namespace", 		string);
+	READ_OPTION(chatMessageType,	std::string, "chatMessageType",	string);
+	READ_OPTION(usedMessagesFile,	std::string, "usedMessagesFile",	string);
+	READ_OPTION(unusedMessagesReport, std::string, "unusedMessagesReport", string);
+	READ_OPTION(idRegistryFile,		std::string, "idRegistry",		string);
+
+	READ_OPTION(shardSize,			size_t, "shardSize",			number_unsigned);
+	READ_OPTION(shardPrefixSeparator, std::string, "shardPrefixSeparator", string);
+
+	// Read emit mode:
+	{
+		auto emitIt = j.find("emitMode");
+		if (emitIt != j.end())
+		{
+			if (emitIt->type() != json::value_t::string)
+				throw std::runtime_error("Could not parse options file - \"emitMode\" value is not a string.");
+
+			auto const& emitMode = emitIt->get_ref<std::string const&>();
+			if (emitMode == "classes")				opts_.emitMode = EmitMode::Classes;
+			else if (emitMode == "stringTable")		opts_.emitMode = EmitMode::StringTable;
+			else if (emitMode == "catalog")			opts_.emitMode = EmitMode::Catalog;
+			else if (emitMode == "extern")			opts_.emitMode = EmitMode::Extern;
+			else
+				throw std::runtime_error("Could not parse options file - \"emitMode\" must be one of: \"classes\", \"stringTable\", \"catalog\", \"extern\".");
+		}
+	}
+
+	// Read shard mode:
+	{
+		auto shardIt = j.find("shardBy");
+		if (shardIt != j.end())
+		{
+			if (shardIt->type() != json::value_t::string)
+				throw std::runtime_error("Could not parse options file - \"shardBy\" value is not a string.");
+
+			auto const& shardBy = shardIt->get_ref<std::string const&>();
+			if (shardBy == "none")			opts_.shardBy = ShardMode::None;
+			else if (shardBy == "count")	opts_.shardBy = ShardMode::Count;
+			else if (shardBy == "prefix")	opts_.shardBy = ShardMode::Prefix;
+			else if (shardBy == "category")	opts_.shardBy = ShardMode::Category;
+			else
+				throw std::runtime_error("Could not parse options file - \"shardBy\" must be one of: \"none\", \"count\", \"prefix\", \"category\".");
+		}
+	}
+
+	// Read header files:
+	{
+		auto headersIt = j.find("headerFiles");
+
+		if (headersIt != j.end())
+		{
+			if (headersIt->type() != json::value_t::array)
+				throw std::runtime_error("Could not parse options file - \"headerFiles\" field not exists or is not an array.");
+			
+			for(auto const& [_, value] : headersIt->items())
+			{
+				if (value.type() != json::value_t::string)
+					continue;
+
+				opts_.headerFiles.push_back(value.get<std::string>());
+			}
+		}
+	}
+
+	// Read language encodings:
+	{
+		auto encodingsIt = j.find("languageEncodings");
+
+		if (encodingsIt != j.end())
+		{
+			if (encodingsIt->type() != json::value_t::object)
+				throw std::runtime_error("Could not parse options file - \"languageEncodings\" value is not an object.");
+
+			for(auto const& [langId, value] : encodingsIt->items())
+			{
+				if (value.type() != json::value_t::string)
+					throw std::runtime_error("Could not parse options file - \"languageEncodings\" value of \"" + langId + "\" is not a string.");
+
+				auto const& name = value.get_ref<std::string const&>();
+				if (!Codepage::find(name))
+					throw std::runtime_error("Could not parse options file - \"languageEncodings\" uses unsupported encoding \"" + name + "\".");
+
+				opts_.languageEncodings[langId] = name;
+			}
+		}
+	}
+
+	// Read selected languages:
+	{
+		auto languagesIt = j.find("languages");
+
+		if (languagesIt != j.end())
+		{
+			if (languagesIt->type() != json::value_t::array)
+				throw std::runtime_error("Could not parse options file - \"languages\" value is not an array.");
+
+			for(auto const& [_, value] : languagesIt->items())
+			{
+				if (value.type() != json::value_t::string)
+					throw std::runtime_error("Could not parse options file - \"languages\" has an entry that is not a string.");
+
+				opts_.languages.push_back(value.get<std::string>());
+			}
+		}
+	}
+
+	// Read language fallbacks:
+	{
+		auto fallbacksIt = j.find("languageFallbacks");
+
+		if (fallbacksIt != j.end())
+		{
+			if (fallbacksIt->type() != json::value_t::object)
+				throw std::runtime_error("Could not parse options file - \"languageFallbacks\" value is not an object.");
+
+			for(auto const& [langId, value] : fallbacksIt->items())
+			{
+				if (value.type() != json::value_t::array)
+					throw std::runtime_error("Could not parse options file - \"languageFallbacks\" value of \"" + langId + "\" is not an array.");
+
+				auto& chain = opts_.languageFallbacks[langId];
+				for (auto const& fallback : value)
+				{
+					if (fallback.type() != json::value_t::string)
+						throw std::runtime_error("Could not parse options file - \"languageFallbacks\" value of \"" + langId + "\" has an entry that is not a string.");
+
+					chain.push_back(fallback.get<std::string>());
+				}
+			}
+		}
+	}
+
+	// Read usage scan paths:
+	{
+		auto pathsIt = j.find("usageScanPaths");
+
+		if (pathsIt != j.end())
+		{
+			if (pathsIt->type() != json::value_t::array)
+				throw std::runtime_error("Could not parse options file - \"usageScanPaths\" value is not an array.");
+
+			for(auto const& [_, value] : pathsIt->items())
+			{
+				if (value.type() != json::value_t::string)
+					continue;
+
+				opts_.usageScanPaths.push_back(value.get<std::string>());
+			}
+		}
+	}
+
+	#undef READ_OPTION
+
+	if (!opts_.usedMessagesFile.empty() || !opts_.usageScanPaths.empty())
+		readUsedMessages(opts_);
+
+	if (!opts_.idRegistryFile.empty())
+		opts_.idRegistry = std::make_shared<IdRegistry>(opts_.idRegistryFile);
+}
+
+////////////////////////////////////////////////
+// Command line flags that replace values of the options file.
+auto applyCliOptions(AppOptions& opts_, CliOptions const& cli_) -> void
+{
+	if (!cli_.languages.empty())
+		opts_.languages = cli_.languages;
+}
+
+////////////////////////////////////////////////
+// Resolves the set of referenced uniqueNames. Runs once per options file,
+// so "--watch" and "--batch" scan the game code only when the options are read.
+auto readUsedMessages(AppOptions& opts_) -> void
+{
+	namespace fs = std::filesystem;
+
+	auto used = std::make_shared< std::unordered_set<std::string> >();
+
+	if (!opts_.usedMessagesFile.empty())
+	{
+		InputFile listFile(opts_.usedMessagesFile);
+		if (!listFile.isOpen())
+			throw std::runtime_error("Could not parse options file - could not open \"" + opts_.usedMessagesFile + "\" used messages file.");
+
+		auto contents = listFile.contents();
+		while (!contents.empty())
+		{
+			size_t end = contents.find('\n');
+			auto line = contents.substr(0, end);
+			contents.remove_prefix(end == std::string_view::npos ? contents.size() : end + 1);
+
+			while (!line.empty() && std::isspace(static_cast<unsigned char>(line.front())))
+				line.remove_prefix(1);
+			while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back())))
+				line.remove_suffix(1);
+
+			if (!line.empty() && line.front() != '#')
+				used->emplace(line);
+		}
+	}
+
+	if (!opts_.usageScanPaths.empty())
+	{
+		auto isSource = [](fs::path const& path_)
+		{
+			static std::unordered_set<std::string> const extensions = {
+				".c", ".cc", ".cpp", ".cxx", ".c++", ".h", ".hh", ".hpp", ".hxx", ".h++", ".inl", ".ipp", ".tpp", ".ixx", ".cppm"
+			};
+			auto ext = path_.extension().string();
+			std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch_) { return static_cast<char>(std::tolower(ch_)); });
+			return extensions.count(ext) != 0;
+		};
+
+		std::vector<std::string> files;
+		for (auto const& scanPath : opts_.usageScanPaths)
+		{
+			std::error_code ec;
+			if (fs::is_regular_file(scanPath, ec))
+			{
+				files.push_back(scanPath);
+				continue;
+			}
+			if (!fs::is_directory(scanPath, ec))
+				throw std::runtime_error("Could not parse options file - \"usageScanPaths\" entry \"" + scanPath + "\" is not a file or directory.");
+
+			for (auto it = fs::recursive_directory_iterator(scanPath, fs::directory_options::skip_permission_denied, ec);
+				!ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+			{
+				if (it->is_regular_file(ec) && isSource(it->path()))
+					files.push_back(it->path().string());
+			}
+			if (ec)
+				throw std::runtime_error("Could not parse options file - could not scan \"" + scanPath + "\" - " + ec.message());
+		}
+
+		scanIdentifiers(files, *used);
+	}
+
+	opts_.usedMessages = std::move(used);
+}
+
+////////////////////////////////////////////////
+// Collects every C/C++ identifier of the files, on one thread per hardware thread.
+// Comments and string literals are scanned too, which can only keep extra messages.
+auto scanIdentifiers(std::vector<std::string> const& files_, std::unordered_set<std::string>& identifiers_) -> void
+{
+	static auto const identifierChars = []
+	{
+		std::array<bool, 256> table{};
+		for (int ch = 0; ch < 256; ++ch)
+			table[ch] = std::isalnum(ch) || ch == '_';
+		return table;
+	}();
+
+	size_t threadCount = std::min<size_t>(files_.size(), std::max(1u, std::thread::hardware_concurrency()));
+
+	std::vector< std::unordered_set<std::string> > found(threadCount);
+	std::vector<std::string> failed(threadCount);
+	std::atomic<size_t> nextFile{ 0 };
+
+	auto scan = [&](size_t thread_)
+	{
+		std::unordered_set<std::string>& identifiers = found[thread_];
+		for (size_t i = nextFile++; i < files_.size(); i = nextFile++)
+		{
+			InputFile file(files_[i]);
+			if (!file.isOpen())
+			{
+				failed[thread_] = files_[i];
+				return;
+			}
+
+			auto text = file.contents();
+			size_t pos = 0;
+			while (pos < text.size())
+			{
+				if (!identifierChars[static_cast<unsigned char>(text[pos])])
+				{
+					++pos;
+					continue;
+				}
+
+				size_t begin = pos;
+				while (pos < text.size() && identifierChars[static_cast<unsigned char>(text[pos])])
+					++pos;
+
+				// Numbers can't name a message:
+				if (!std::isdigit(static_cast<unsigned char>(text[begin])))
+					identifiers.emplace(text.substr(begin, pos - begin));
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < threadCount; ++t)
+		threads.emplace_back(scan, t);
+	if (threadCount > 0)
+		scan(0);
+	for (auto& thread : threads)
+		thread.join();
+
+	for (size_t t = 0; t < threadCount; ++t)
+	{
+		if (!failed[t].empty())
+			throw std::runtime_error("Could not parse options file - could not open \"" + failed[t] + "\" source file for usage scan.");
+
+		if (identifiers_.empty())
+			identifiers_.swap(found[t]);
+		else
+			identifiers_.merge(found[t]);
+	}
+}
+
+////////////////////////////////////////////////
+InputFile::InputFile(std::string_view path_, Mode mode_)
+{
+	std::string path(path_);
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size;
+	if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || mode_ == Mode::Read)
+	{
+		readAll(file);
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		return;
+	}
+
+	opened = true;
+	if (size.QuadPart == 0)
+		return;
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping)
+		mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (!mapped)
+	{
+		opened = false;
+		readAll(file);
+		return;
+	}
+
+	mappedSize	= static_cast<size_t>(size.QuadPart);
+	view		= std::string_view(static_cast<char const*>(mapped), mappedSize);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat st = {};
+	if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || mode_ == Mode::Read)
+	{
+		readAll(fd, S_ISREG(st.st_mode) ? static_cast<size_t>(st.st_size) : 0);
+		::close(fd);
+		return;
+	}
+
+	opened = true;
+	if (st.st_size == 0)
+	{
+		::close(fd);
+		return;
+	}
+
+	void* addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED)
+	{
+		opened = false;
+		readAll(fd, static_cast<size_t>(st.st_size));
+		::close(fd);
+		return;
+	}
+	::close(fd);
+
+	::madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+	mapped		= addr;
+	mappedSize	= static_cast<size_t>(st.st_size);
+	view		= std::string_view(static_cast<char const*>(mapped), mappedSize);
+#endif
+}
+
+////////////////////////////////////////////////
+InputFile::~InputFile()
+{
+#ifdef _WIN32
+	if (mapped)
+		UnmapViewOfFile(mapped);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+#else
+	if (mapped)
+		::munmap(const_cast<void*>(mapped), mappedSize);
+#endif
+}
+
+#ifdef _WIN32
+////////////////////////////////////////////////
+auto InputFile::readAll(HANDLE file_) -> void
+{
+	buffer.reserve(1 * 1024 * 1024);
+
+	// Pipes deliver data in 64 KiB chunks on most systems:
+	char chunk[64 * 1024];
+	for (;;)
+	{
+		DWORD bytesRead = 0;
+		if (!ReadFile(file_, chunk, sizeof(chunk), &bytesRead, nullptr))
+		{
+			// The writer closing a pipe ends it with ERROR_BROKEN_PIPE:
+			if (GetLastError() == ERROR_BROKEN_PIPE)
+				break;
+			return;
+		}
+		if (bytesRead == 0)
+			break;
+		buffer.append(chunk, bytesRead);
+	}
+
+	view	= buffer;
+	opened	= true;
+}
+#else
+////////////////////////////////////////////////
+auto InputFile::readAll(int fd_, size_t sizeHint_) -> void
+{
+	buffer.reserve(std::max<size_t>(sizeHint_, 1 * 1024 * 1024));
+
+	char chunk[64 * 1024];
+	for (;;)
+	{
+		ssize_t bytesRead = ::read(fd_, chunk, sizeof(chunk));
+		if (bytesRead == 0)
+			break;
+		if (bytesRead < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		buffer.append(chunk, static_cast<size_t>(bytesRead));
+	}
+
+	view	= buffer;
+	opened	= true;
+}
+#endif
+
+////////////////////////////////////////////////
+FileSink::FileSink(std::string_view path_)
+{
+	std::string path(path_);
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	opened = (file != INVALID_HANDLE_VALUE);
+#else
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	opened = (fd >= 0);
+#endif
+
+	if (opened)
+		buffer = std::make_unique<char[]>(BufferSize);
+}
+
+////////////////////////////////////////////////
+FileSink::~FileSink()
+{
+	// Errors are reported only by an explicit close():
+	try
+	{
+		close();
+	}
+	catch (...)
+	{
+	}
+}
+
+////////////////////////////////////////////////
+auto FileSink::write(std::string_view data_) -> void
+{
+	if (!opened)
+		return;
+
+	if (used + data_.size() <= BufferSize)
+	{
+		std::memcpy(buffer.get() + used, data_.data(), data_.size());
+		used += data_.size();
+		return;
+	}
+
+	writeAll(std::string_view(buffer.get(), used), data_);
+	written += used + data_.size();
+	used = 0;
+}
+
+////////////////////////////////////////////////
+auto FileSink::close() -> void
+{
+	if (!opened)
+		return;
+
+	opened = false;
+	try
+	{
+		writeAll(std::string_view(buffer.get(), used), {});
+		written += used;
+		used = 0;
+	}
+	catch (...)
+	{
+#ifdef _WIN32
+		CloseHandle(file);
+#else
+		::close(fd);
+#endif
+		throw;
+	}
+
+#ifdef _WIN32
+	CloseHandle(file);
+#else
+	if (::close(fd) != 0)
+		throw std::runtime_error(std::string("Could not write output file - ") + std::strerror(errno) + ".");
+#endif
+}
+
+////////////////////////////////////////////////
+auto FileSink::writeAll(std::string_view first_, std::string_view second_) -> void
+{
+#ifdef _WIN32
+	for (auto data : { first_, second_ })
+	{
+		while (!data.empty())
+		{
+			DWORD size = static_cast<DWORD>(std::min<size_t>(data.size(), 1u << 30));
+			DWORD done = 0;
+			if (!WriteFile(file, data.data(), size, &done, nullptr))
+				throw std::runtime_error("Could not write output file - WriteFile failed.");
+			data.remove_prefix(done);
+		}
+	}
+#else
+	while (!first_.empty() || !second_.empty())
+	{
+		iovec parts[2] = {
+			{ const_cast<char*>(first_.data()), first_.size() },
+			{ const_cast<char*>(second_.data()), second_.size() }
+		};
+
+		ssize_t done = ::writev(fd, parts, 2);
+		if (done < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("Could not write output file - ") + std::strerror(errno) + ".");
+		}
+
+		size_t fromFirst = std::min(static_cast<size_t>(done), first_.size());
+		first_.remove_prefix(fromFirst);
+		second_.remove_prefix(static_cast<size_t>(done) - fromFirst);
+	}
+#endif
+}
+
+////////////////////////////////////////////////
+FileWatcher::FileWatcher(std::vector<std::string> paths_)
+{
+	namespace fs = std::filesystem;
+
+	std::vector<std::string> directories;
+	for (auto& path : paths_)
+	{
+		auto directory = fs::absolute(path).parent_path().string();
+		if (std::find(directories.begin(), directories.end(), directory) == directories.end())
+			directories.push_back(std::move(directory));
+
+		files.push_back(Watched{ std::move(path), {}, 0 });
+	}
+	changedFiles();
+
+#ifdef _WIN32
+	for (auto const& directory : directories)
+	{
+		HANDLE handle = FindFirstChangeNotificationA(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+		if (handle != INVALID_HANDLE_VALUE)
+			handles.push_back(handle);
+	}
+#elif defined(__linux__)
+	fd = inotify_init1(IN_CLOEXEC);
+	for (auto const& directory : directories)
+	{
+		if (fd >= 0)
+			inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	}
+#endif
+}
+
+////////////////////////////////////////////////
+FileWatcher::~FileWatcher()
+{
+#ifdef _WIN32
+	for (auto handle : handles)
+		FindCloseChangeNotification(handle);
+#elif defined(__linux__)
+	if (fd >= 0)
+		::close(fd);
+#endif
+}
+
+////////////////////////////////////////////////
+auto FileWatcher::wait() -> std::vector<size_t>
+{
+	for (;;)
+	{
+		waitForActivity();
+
+		auto changed = changedFiles();
+		if (!changed.empty())
+			return changed;
+	}
+}
+
+////////////////////////////////////////////////
+auto FileWatcher::waitForActivity() -> void
+{
+#ifdef _WIN32
+	if (!handles.empty())
+	{
+		DWORD result = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, INFINITE);
+		if (result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + handles.size())
+			FindNextChangeNotification(handles[result - WAIT_OBJECT_0]);
+
+		// Notifications arrive while the file is still being written:
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		return;
+	}
+#elif defined(__linux__)
+	if (fd >= 0)
+	{
+		// Events are only a wake-up, the changed files are found by changedFiles():
+		alignas(inotify_event) char events[16 * 1024];
+		while (::read(fd, events, sizeof(events)) < 0 && errno == EINTR)
+			;
+		return;
+	}
+#endif
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+////////////////////////////////////////////////
+auto FileWatcher::changedFiles() -> std::vector<size_t>
+{
+	namespace fs = std::filesystem;
+
+	std::vector<size_t> changed;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		// Files replaced by a rename may be missing for a moment:
+		std::error_code ec;
+		auto time = fs::last_write_time(files[i].path, ec);
+		auto size = ec ? 0 : fs::file_size(files[i].path, ec);
+		if (ec)
+			continue;
+
+		if (time != files[i].time || size != files[i].size)
+		{
+			files[i].time = time;
+			files[i].size = size;
+			changed.push_back(i);
+		}
+	}
+	return changed;
+}
+
+////////////////////////////////////////////////
+Codepage::Codepage(std::string_view name_, char16_t const (&upper_)[128])
+	: codepageName(name_)
+{
+	for (size_t i = 0; i < 128; ++i)
+	{
+		// Bytes not defined by the codepage are 0:
+		if (upper_[i] != 0)
+			bytes.emplace_back(upper_[i], static_cast<unsigned char>(0x80 + i));
+	}
+	std::sort(bytes.begin(), bytes.end());
+}
+
+////////////////////////////////////////////////
+auto Codepage::find(std::string_view name_) -> Codepage const*
+{
+	static constexpr char16_t windows1250[128] = {
+		0x20AC, 0x0000, 0x201A, 0x0000, 0x201E, 0x2026, 0x2020, 0x2021, 0x0000, 0x2030, 0x0160, 0x2039, 0x015A, 0x0164, 0x017D, 0x0179,
+		0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x0000, 0x2122, 0x0161, 0x203A, 0x015B, 0x0165, 0x017E, 0x017A,
+		0x00A0, 0x02C7, 0x02D8, 0x0141, 0x00A4, 0x0104, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x015E, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x017B,
+		0x00B0, 0x00B1, 0x02DB, 0x0142, 0x00B4, 0x00B5, 0x00B6, 0x00B7, 0x00B8, 0x0105, 0x015F, 0x00BB, 0x013D, 0x02DD, 0x013E, 0x017C,
+		0x0154, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7, 0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,
+		0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7, 0x0158, 0x016E, 0x00DA, 0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF,
+		0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7, 0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F,
+		0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x00F7, 0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9,
+	};
+	static constexpr char16_t windows1251[128] = {
+		0x0402, 0x0403, 0x201A, 0x0453, 0x201E, 0x2026, 0x2020, 0x2021, 0x20AC, 0x2030, 0x0409, 0x2039, 0x040A, 0x040C, 0x040B, 0x040F,
+		0x0452, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x0000, 0x2122, 0x0459, 0x203A, 0x045A, 0x045C, 0x045B, 0x045F,
+		0x00A0, 0x040E, 0x045E, 0x0408, 0x00A4, 0x0490, 0x00A6, 0x00A7, 0x0401, 0x00A9, 0x0404, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x0407,
+		0x00B0, 0x00B1, 0x0406, 0x0456, 0x0491, 0x00B5, 0x00B6, 0x00B7, 0x0451, 0x2116, 0x0454, 0x00BB, 0x0458, 0x0405, 0x0455, 0x0457,
+		0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417, 0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+		0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427, 0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+		0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437, 0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+		0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447, 0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+	};
+	static constexpr char16_t windows1252[128] = {
+		0x20AC, 0x0000, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x0000, 0x017D, 0x0000,
+		0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x0000, 0x017E, 0x0178,
+		0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+		0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7, 0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+		0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+		0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7, 0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+		0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7, 0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+		0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7, 0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+	};
+	static constexpr char16_t windows1253[128] = {
+		0x20AC, 0x0000, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x0000, 0x2030, 0x0000, 0x2039, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x0000, 0x2122, 0x0000, 0x203A, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x00A0, 0x0385, 0x0386, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x0000, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x2015,
+		0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x0384, 0x00B5, 0x00B6, 0x00B7, 0x0388, 0x0389, 0x038A, 0x00BB, 0x038C, 0x00BD, 0x038E, 0x038F,
+		0x0390, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397, 0x0398, 0x0399, 0x039A, 0x039B, 0x039C, 0x039D, 0x039E, 0x039F,
+		0x03A0, 0x03A1, 0x0000, 0x03A3, 0x03A4, 0x03A5, 0x03A6, 0x03A7, 0x03A8, 0x03A9, 0x03AA, 0x03AB, 0x03AC, 0x03AD, 0x03AE, 0x03AF,
+		0x03B0, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5, 0x03B6, 0x03B7, 0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF,
+		0x03C0, 0x03C1, 0x03C2, 0x03C3, 0x03C4, 0x03C5, 0x03C6, 0x03C7, 0x03C8, 0x03C9, 0x03CA, 0x03CB, 0x03CC, 0x03CD, 0x03CE, 0x0000,
+	};
+	static constexpr char16_t windows1254[128] = {
+		0x20AC, 0x0000, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x0000, 0x0000, 0x0178,
+		0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+		0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7, 0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+		0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+		0x011E, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7, 0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x0130, 0x015E, 0x00DF,
+		0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7, 0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+		0x011F, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7, 0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x0131, 0x015F, 0x00FF,
+	};
+	static constexpr char16_t windows1257[128] = {
+		0x20AC, 0x0000, 0x201A, 0x0000, 0x201E, 0x2026, 0x2020, 0x2021, 0x0000, 0x2030, 0x0000, 0x2039, 0x0000, 0x00A8, 0x02C7, 0x00B8,
+		0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x0000, 0x2122, 0x0000, 0x203A, 0x0000, 0x00AF, 0x02DB, 0x0000,
+		0x00A0, 0x0000, 0x00A2, 0x00A3, 0x00A4, 0x0000, 0x00A6, 0x00A7, 0x00D8, 0x00A9, 0x0156, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00C6,
+		0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7, 0x00F8, 0x00B9, 0x0157, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00E6,
+		0x0104, 0x012E, 0x0100, 0x0106, 0x00C4, 0x00C5, 0x0118, 0x0112, 0x010C, 0x00C9, 0x0179, 0x0116, 0x0122, 0x0136, 0x012A, 0x013B,
+		0x0160, 0x0143, 0x0145, 0x00D3, 0x014C, 0x00D5, 0x00D6, 0x00D7, 0x0172, 0x0141, 0x015A, 0x016A, 0x00DC, 0x017B, 0x017D, 0x00DF,
+		0x0105, 0x012F, 0x0101, 0x0107, 0x00E4, 0x00E5, 0x0119, 0x0113, 0x010D, 0x00E9, 0x017A, 0x0117, 0x0123, 0x0137, 0x012B, 0x013C,
+		0x0161, 0x0144, 0x0146, 0x00F3, 0x014D, 0x00F5, 0x00F6, 0x00F7, 0x0173, 0x0142, 0x015B, 0x016B, 0x00FC, 0x017C, 0x017E, 0x02D9,
+	};
+
+	static Codepage const codepages[] = {
+		Codepage("windows-1250", windows1250),
+		Codepage("windows-1251", windows1251),
+		Codepage("windows-1252", windows1252),
+		Codepage("windows-1253", windows1253),
+		Codepage("windows-1254", windows1254),
+		Codepage("windows-1257", windows1257)
+	};
+
+	std::string name(name_);
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char ch_) { return static_cast<char>(std::tolower(ch_)); });
+	if (name.compare(0, 2, "cp") == 0)
+		name = "windows-" + name.substr(2);
+
+	for (auto const& codepage : codepages)
+	{
+		if (codepage.name() == name)
+			return &codepage;
+	}
+	return nullptr;
+}
+
+////////////////////////////////////////////////
+auto Codepage::encode(std::string_view text_, std::string& output_) const -> size_t
+{
+	size_t pos = 0;
+	while (pos < text_.size())
+	{
+		auto lead = static_cast<unsigned char>(text_[pos]);
+		if (lead < 0x80)
+		{
+			output_ += text_[pos++];
+			continue;
+		}
+
+		// Decode one UTF-8 sequence, overlong forms and surrogates are invalid:
+		size_t length = (lead >= 0xC2 && lead <= 0xDF) ? 2 : (lead >= 0xE0 && lead <= 0xEF) ? 3 : (lead >= 0xF0 && lead <= 0xF4) ? 4 : 0;
+		if (length == 0 || pos + length > text_.size())
+			return pos;
+
+		char32_t codePoint = lead & (0xFF >> (length + 1));
+		for (size_t i = 1; i < length; ++i)
+		{
+			auto cont = static_cast<unsigned char>(text_[pos + i]);
+			if ((cont & 0xC0) != 0x80)
+				return pos;
+			codePoint = (codePoint << 6) | (cont & 0x3F);
+		}
+		if ((length == 3 && (codePoint < 0x800 || (codePoint >= 0xD800 && codePoint <= 0xDFFF)))
+			|| (length == 4 && (codePoint < 0x10000 || codePoint > 0x10FFFF)))
+			return pos;
+
+		auto it = std::lower_bound(bytes.begin(), bytes.end(), std::make_pair(codePoint, static_cast<unsigned char>(0)));
+		if (it == bytes.end() || it->first != codePoint)
+			return pos;
+
+		output_ += static_cast<char>(it->second);
+		pos += length;
+	}
+	return std::string_view::npos;
 }
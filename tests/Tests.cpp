@@ -0,0 +1,151 @@
+// Regression tests of the samp-ct generators, built from tests/cpackage.json.
+// Prints every failed check and exits with 1 when there was one.
+
+// Every generator of the tool, with its main() out of the way:
+#define main sampCtMain
+#include "../src/Main.cpp"
+#undef main
+
+namespace
+{
+
+size_t failures = 0;
+
+////////////////////////////////////////////////
+auto check(bool passed_, std::string_view what_) -> void
+{
+	if (passed_)
+		return;
+
+	fmt::print("FAILED: {}\n", what_);
+	++failures;
+}
+
+////////////////////////////////////////////////
+// Project with a single message in English.
+auto singleTextProject(std::string_view processed_) -> std::string
+{
+	json project = {
+		{ "languages",		{ { { "id", "en" }, { "name", "English" } } } },
+		{ "chatMessages",	{ { { "uniqueName", "Message" }, { "content", { { "en", { { "comment", "" }, { "processed", processed_ } } } } } } } }
+	};
+	return project.dump();
+}
+
+////////////////////////////////////////////////
+// Contents of every generated file, in order.
+auto generate(std::string_view options_, std::string_view project_, bool streaming_) -> std::string
+{
+	AppOptions opts;
+	readAppOptions(opts, options_);
+
+	CliOptions cli;
+	cli.streaming = streaming_;
+
+	std::string output;
+	for (auto const& file : generateOutputFiles(opts, cli, project_, "out.h", GenerationContext{}))
+		output += file.contents;
+	return output;
+}
+
+////////////////////////////////////////////////
+// Generation has to fail with the usual error, with the parsed and the streaming parser.
+auto checkRejected(std::string_view options_, std::string_view project_, std::string_view what_) -> void
+{
+	for (bool streaming : { false, true })
+	{
+		std::string result;
+		try
+		{
+			generate(options_, project_, streaming);
+			result = "was accepted";
+		}
+		catch (std::runtime_error const&)
+		{
+		}
+		catch (std::exception const& ex_)
+		{
+			result = fmt::format("failed with \"{}\"", ex_.what());
+		}
+		check(result.empty(), fmt::format("{} {}{}", what_, result, streaming ? " by the streaming parser" : ""));
+	}
+}
+
+////////////////////////////////////////////////
+auto testFormatArgumentIds() -> void
+{
+	constexpr std::string_view Options = R"({ "typedFormat": true })";
+
+	check(generate(Options, singleTextProject("x {32}"), false).find("a32") != std::string::npos, "argument id 32 is accepted");
+	checkRejected(Options, singleTextProject("x {33}"), "argument id above 32");
+	checkRejected(Options, singleTextProject("x {2000000000}"), "huge argument id");
+	checkRejected(Options, singleTextProject("x {99999999999999999999}"), "overflowing argument id");
+}
+
+////////////////////////////////////////////////
+auto testLanguageSubset() -> void
+{
+	// "B" has no English text, so its Polish text must stay in the slot of Polish:
+	constexpr std::string_view Project = R"({
+		"languages": [ { "id": "de", "name": "German" }, { "id": "en", "name": "English" }, { "id": "pl", "name": "Polish" } ],
+		"chatMessages": [
+			{ "uniqueName": "A", "content": {
+				"pl": { "comment": "", "processed": "A-pl" }, "en": { "comment": "", "processed": "A-en" }, "de": { "comment": "", "processed": "A-de" } } },
+			{ "uniqueName": "B", "content": { "pl": { "comment": "", "processed": "B-pl" } } }
+		]
+	})";
+
+	for (bool streaming : { false, true })
+	{
+		auto classes = generate(R"({ "languages": [ "en", "pl" ], "useCompileMacro": false })", Project, streaming);
+		check(classes.find("result[0] = \"A-en\";\n\t\tresult[1] = \"A-pl\";") != std::string::npos, "subset texts are placed by language");
+		check(classes.find("std::array<std::string_view, 2> result;\n\t\tresult[1] = \"B-pl\";") != std::string::npos, "missing subset text leaves its slot empty");
+		check(classes.find("A-de") == std::string::npos, "languages left out of the subset are not generated");
+
+		auto enumClasses = generate(R"({ "languages": [ "en", "pl" ], "languageEnum": "game::Languages", "useCompileMacro": false })", Project, streaming);
+		check(enumClasses.find("std::array<std::string_view, 2> result;\n\t\tresult[1] = \"B-pl\";") != std::string::npos, "missing subset text leaves its slot empty with \"languageEnum\"");
+
+		auto fallback = generate(R"({ "languages": [ "en", "pl" ], "languageFallbacks": { "en": [ "pl" ] }, "useCompileMacro": false })", Project, streaming);
+		check(fallback.find("result[0] = \"B-pl\";") != std::string::npos && fallback.find("result[1] = \"B-pl\";") != std::string::npos,
+			"fallback text fills the slot of the missing language");
+
+		auto externSource = generate(R"({ "languages": [ "en", "pl" ], "emitMode": "extern" })", Project, streaming);
+		check(externSource.find("std::array<std::string_view, 2> result{};\n\tresult[1] = \"B-pl\";") != std::string::npos, "extern texts are placed by language");
+
+		auto stringTable = generate(R"({ "languages": [ "en", "pl" ], "emitMode": "stringTable" })", Project, streaming);
+		check(stringTable.find("std::array<StringTable, 2> result{};") != std::string::npos, "string table has a table for every selected language");
+	}
+}
+
+////////////////////////////////////////////////
+auto testEscapeSequences() -> void
+{
+	// String tables hold the bytes the escapes stand for:
+	constexpr std::string_view Options = R"({ "emitMode": "stringTable" })";
+
+	check(generate(Options, singleTextProject(R"(caf\u00e9 \x41\102)"), false).find("caf\xc3\xa9 AB") != std::string::npos, "valid escapes are decoded");
+	checkRejected(Options, singleTextProject(R"(x \uZZ)"), "'\\u' without hexadecimal digits");
+	checkRejected(Options, singleTextProject(R"(x \u12)"), "short '\\u' at the end of the text");
+	checkRejected(Options, singleTextProject(R"(x \U0001F60)"), "short '\\U' at the end of the text");
+	checkRejected(Options, singleTextProject(R"(x \U00110000)"), "'\\U' above U+10FFFF");
+	checkRejected(Options, singleTextProject(R"(x \xg)"), "'\\x' without hexadecimal digits");
+	checkRejected(Options, singleTextProject(R"(x \x100)"), "'\\x' above a byte");
+}
+
+}
+
+////////////////////////////////////////////////
+int main()
+{
+	testFormatArgumentIds();
+	testLanguageSubset();
+	testEscapeSequences();
+
+	if (failures)
+	{
+		fmt::print("{} checks failed.\n", failures);
+		return 1;
+	}
+	fmt::print("All checks passed.\n");
+	return 0;
+}